@@ -0,0 +1,216 @@
+// Benchmarks, build with optimizations:
+//   g++ -std=c++17 -O2 -pthread bench.cpp -o bench && ./bench
+// the scheduler benchmark needs -std=c++20
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <queue>
+#include <random>
+#include "kway_merge.cpp"
+#include "persistent_hollow_heap.cpp"
+#if __cplusplus >= 202002L
+#include "scheduler.cpp"
+#endif
+
+using namespace std;
+
+// merges runs of random sorted ints, every run is runLength ints long.
+// Every run keeps two blocks of blockSize bytes in memory
+void benchKWayMerge(int runCount, int runLength, size_t blockSize) {
+    // a private directory, so concurrent benchmark runs do not overwrite each other's files
+    string directory = (filesystem::temp_directory_path() / "hollow-heap-bench-XXXXXX").string();
+    if (mkdtemp(&directory[0]) == nullptr) {
+        throw runtime_error("Not able to create a directory from " + directory);
+    }
+    mt19937 rng(42);
+    vector<string> inputs;
+    for (int run = 0; run < runCount; run++) {
+        vector<int> values(runLength);
+        for (int &value : values) {
+            value = (int) rng();
+        }
+        sort(values.begin(), values.end());
+
+        inputs.push_back(directory + "/bench-run-" + to_string(run) + ".bin");
+        RunWriter<int> writer(inputs.back());
+        for (int value : values) {
+            writer.write(value);
+        }
+        writer.close();
+    }
+
+    string output = directory + "/bench-merged.bin";
+    MergeStats stats = kwayMerge<int>(inputs, output, blockSize);
+    cout << "k-way merge of " << runCount << " runs x " << runLength << " ints: "
+         << stats.megabytesPerSecond() << " MB/s ("
+         << stats.bytesRead << " bytes in " << stats.seconds << " s)" << endl;
+
+    filesystem::remove_all(directory);
+}
+
+// single-source shortest paths on a random graph with edgesPerVertex out-edges per vertex
+// and weights in [1, maxWeight]. Reports how many decreaseKeys were done in place
+void benchDijkstra(int vertices, int edgesPerVertex, int maxWeight) {
+    mt19937 rng(42);
+    vector<vector<pair<int, int>>> edges(vertices);
+    for (int from = 0; from < vertices; from++) {
+        for (int e = 0; e < edgesPerVertex; e++) {
+            edges[from].emplace_back(rng() % vertices, 1 + rng() % maxWeight);
+        }
+    }
+
+    auto start = chrono::steady_clock::now();
+    HollowHeap<pair<long long, int>> heap;
+    vector<shared_ptr<Item<pair<long long, int>>>> items(vertices);
+    vector<long long> distance(vertices, -1);
+    long long decreases = 0;
+    items[0] = heap.insert({0, 0});
+    while (!heap.isEmpty()) {
+        pair<long long, int> closest = heap.extractMin();
+        int from = closest.second;
+        distance[from] = closest.first;
+        for (pair<int, int> &edge : edges[from]) {
+            int to = edge.first;
+            long long candidate = closest.first + edge.second;
+            if (distance[to] >= 0) {
+                continue;
+            }
+            if (items[to] == nullptr) {
+                items[to] = heap.insert({candidate, to});
+            } else if (candidate < items[to]->getValue().first) {
+                heap.decreaseKey(items[to], {candidate, to});
+                decreases++;
+            }
+        }
+    }
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+
+    cout << "dijkstra on " << vertices << " vertices x " << edgesPerVertex << " edges, weights up to "
+         << maxWeight << ": " << elapsed.count() << " ms, " << decreases << " decreaseKeys, "
+         << 100.0 * heap.getInPlaceDecreases() / max(1LL, decreases) << "% in place" << endl;
+}
+
+// every fork of a heap of size elements inserts one element and extracts two,
+// as a branch-and-bound search does at a decision point. The base heap extracts
+// a few elements first, so the forks do not repeat the long consolidations
+// that follow a run of inserts
+void benchForks(int size, int forks) {
+    mt19937 rng(42);
+    PersistentHollowHeap<int> base;
+    for (int i = 0; i < size; i++) {
+        base.insert((int) rng());
+    }
+    for (int i = 0; i < 16; i++) {
+        base.extractMin();
+    }
+
+    vector<PersistentHollowHeap<int>> branches;
+    long long copiedNodes = 0;
+    auto start = chrono::steady_clock::now();
+    for (int fork = 0; fork < forks; fork++) {
+        branches.push_back(base.clone());
+        branches.back().insert((int) rng());
+        branches.back().extractMin();
+        branches.back().extractMin();
+        copiedNodes += branches.back().getCopiedNodes();
+    }
+    chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+    cout << forks << " forks of a persistent heap of " << size << " ints: "
+         << elapsed.count() / forks << " ns and "
+         << (double) copiedNodes / forks << " copied nodes per fork" << endl;
+}
+
+#if __cplusplus >= 202002L
+// reference event loop on a std::priority_queue, without cancellation or reprioritization
+class PriorityQueueLoop {
+public:
+    struct Entry {
+        TaskKey key;
+        coroutine_handle<> handle;
+
+        // std::priority_queue puts the largest entry on top
+        bool operator<(const Entry &other) const { return other.key < key; }
+    };
+
+    struct SleepAwaiter {
+        PriorityQueueLoop &loop;
+        SchedulerClock::time_point deadline;
+
+        bool await_ready() { return false; }
+        void await_suspend(coroutine_handle<> handle) {
+            loop.queue.push(Entry{TaskKey{deadline, 0, loop.sequence++}, handle});
+        }
+        void await_resume() {}
+    };
+
+    void spawn(Task task) {
+        queue.push(Entry{TaskKey{SchedulerClock::now(), 0, sequence++}, task.handle});
+    }
+
+    SleepAwaiter sleepUntil(SchedulerClock::time_point deadline) {
+        return SleepAwaiter{*this, deadline};
+    }
+
+    void run() {
+        while (!queue.empty()) {
+            Entry next = queue.top();
+            queue.pop();
+            if (next.key.deadline > SchedulerClock::now()) {
+                this_thread::sleep_until(next.key.deadline);
+            }
+            next.handle.resume();
+        }
+    }
+private:
+    priority_queue<Entry> queue;
+    long long sequence = 0;
+};
+
+// deadlines are spread over a second that has already passed, so no loop ever sleeps
+template <typename Loop>
+Task sleeper(Loop &loop, int rounds, SchedulerClock::time_point base, mt19937 &rng) {
+    for (int i = 0; i < rounds; i++) {
+        co_await loop.sleepUntil(base + chrono::microseconds(rng() % 1000000));
+    }
+}
+
+template <typename Loop>
+double nanosecondsPerWakeup(int tasks, int rounds) {
+    Loop loop;
+    mt19937 rng(42);
+    SchedulerClock::time_point base = SchedulerClock::now() - chrono::hours(1);
+    for (int i = 0; i < tasks; i++) {
+        loop.spawn(sleeper(loop, rounds, base, rng));
+    }
+
+    auto start = chrono::steady_clock::now();
+    loop.run();
+    chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+    // every task also wakes up once when it starts
+    return elapsed.count() / ((long long) tasks * (rounds + 1));
+}
+
+void benchScheduler(int tasks, int rounds) {
+    cout << "scheduler with " << tasks << " tasks x " << rounds << " sleeps: "
+         << nanosecondsPerWakeup<Scheduler>(tasks, rounds) << " ns per wakeup (HollowHeap), "
+         << nanosecondsPerWakeup<PriorityQueueLoop>(tasks, rounds) << " ns per wakeup (std::priority_queue)"
+         << endl;
+}
+#endif
+
+int main() {
+    benchKWayMerge(16, 1 << 18, 1 << 20);
+    benchKWayMerge(1024, 1 << 12, 1 << 14);
+    benchDijkstra(1 << 18, 8, 1000);
+    benchDijkstra(1 << 18, 8, 10);
+    benchForks(1 << 16, 10000);
+#if __cplusplus >= 202002L
+    benchScheduler(1000, 100);
+    benchScheduler(100000, 10);
+#endif
+
+    return 0;
+}
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <unistd.h>
+#include "hollow_heap.cpp"
+#include "run_file.cpp"
+
+using namespace std;
+
+struct IoCounters {
+    long long bytesRead = 0;
+    long long bytesWritten = 0;
+    long long extracts = 0;
+    // bytes read by the last extractMin
+    long long lastExtractBytesRead = 0;
+};
+
+// Priority queue for more elements than fit in memory.
+// At most memoryBudget elements live in an in-memory HollowHeap. When it overflows,
+// it is drained in order into a sorted run file, written in blocks of blockSize bytes.
+// Runs are read back block by block, with the next block prefetched, and merged through
+// a second HollowHeap keyed on the head of every run. Every run keeps a file and two
+// blocks open, so once there are more than maxRuns of them, the smallest ones are merged
+// into one. Only insert and extractMin are supported: elements on disk have no handles.
+// Run files are named by process id and instance and created exclusively, so heaps can
+// share a directory, and a leftover file with the same name makes the spill throw.
+template <typename T>
+class ExternalHollowHeap {
+public:
+    ExternalHollowHeap(
+            const string &directory,
+            int memoryBudget,
+            size_t blockSize = 1 << 20,
+            int maxRuns = 64);
+    ~ExternalHollowHeap();
+    ExternalHollowHeap(const ExternalHollowHeap &) = delete;
+    ExternalHollowHeap &operator=(const ExternalHollowHeap &) = delete;
+
+    bool isEmpty();
+    long long size();
+    T getMin();
+    void insert(T el);
+    T extractMin();
+    int getRunCount();
+    IoCounters getIoCounters();
+private:
+    struct Run {
+        unique_ptr<RunReader<T>> reader;
+        string path;
+        // elements not extracted yet
+        long long size = 0;
+        // runs are numbered in the order they were written
+        long long number = 0;
+        shared_ptr<Item<RunHead<T>>> head;
+    };
+
+    string directory;
+    int memoryBudget;
+    size_t blockSize;
+    int maxRuns;
+    int instance;
+
+    HollowHeap<T> memory;
+    HollowHeap<RunHead<T>> runHeads;
+    // indexed by RunHead::run. The slot of a closed run is reused by the next one
+    vector<Run> runs;
+    vector<int> freeSlots;
+    long long runsWritten = 0;
+    long long count = 0;
+    IoCounters counters;
+
+    void spill();
+    void mergeSmallestRuns();
+    int createRun();
+    void openRun(int run, long long size);
+    void closeRun(int run);
+    bool minIsOnDisk();
+};
+
+template <typename T>
+ExternalHollowHeap<T>::ExternalHollowHeap(
+        const string &directory,
+        int memoryBudget,
+        size_t blockSize,
+        int maxRuns
+): directory(directory), memoryBudget(memoryBudget), blockSize(blockSize), maxRuns(maxRuns) {
+    if (maxRuns < 2) {
+        throw logic_error("At least 2 runs are needed to merge them. Not able to create the heap");
+    }
+    static atomic<int> instances(0);
+    instance = instances++;
+}
+
+template <typename T>
+ExternalHollowHeap<T>::~ExternalHollowHeap() {
+    for (size_t run = 0; run < runs.size(); run++) {
+        if (runs[run].reader != nullptr) {
+            closeRun(run);
+        }
+    }
+}
+
+template <typename T>
+bool ExternalHollowHeap<T>::isEmpty() {
+    return count == 0;
+}
+
+template <typename T>
+long long ExternalHollowHeap<T>::size() {
+    return count;
+}
+
+template <typename T>
+T ExternalHollowHeap<T>::getMin() {
+    if (isEmpty()) {
+        throw logic_error("The heap is empty. Not able to get the minimum value");
+    }
+    return minIsOnDisk() ? runHeads.getMin().key : memory.getMin();
+}
+
+template <typename T>
+void ExternalHollowHeap<T>::insert(T el) {
+    if (memory.size() >= memoryBudget && !memory.isEmpty()) {
+        spill();
+    }
+    memory.insert(el);
+    count++;
+}
+
+template <typename T>
+T ExternalHollowHeap<T>::extractMin() {
+    if (isEmpty()) {
+        throw logic_error("The heap is empty. Not able to extract the minimum value");
+    }
+    count--;
+    counters.extracts++;
+    counters.lastExtractBytesRead = 0;
+    if (!minIsOnDisk()) {
+        return memory.extractMin();
+    }
+
+    RunHead<T> head = runHeads.getMin();
+    RunReader<T> &reader = *runs[head.run].reader;
+    long long bytesBefore = reader.getBytesRead();
+    T minVal = reader.next();
+    runs[head.run].size--;
+    counters.lastExtractBytesRead = reader.getBytesRead() - bytesBefore;
+    counters.bytesRead += counters.lastExtractBytesRead;
+    if (reader.isExhausted()) {
+        runHeads.extractMin();
+        closeRun(head.run);
+    } else {
+        runHeads.replaceMin(RunHead<T>{reader.peek(), head.run});
+    }
+    return minVal;
+}
+
+template <typename T>
+int ExternalHollowHeap<T>::getRunCount() {
+    return runHeads.size();
+}
+
+template <typename T>
+IoCounters ExternalHollowHeap<T>::getIoCounters() {
+    return counters;
+}
+
+// drains the in-memory heap into a new sorted run
+template <typename T>
+void ExternalHollowHeap<T>::spill() {
+    int run = createRun();
+    long long size = memory.size();
+    RunWriter<T> writer(runs[run].path, blockSize, true);
+    while (!memory.isEmpty()) {
+        writer.write(memory.extractMin());
+    }
+    writer.close();
+    counters.bytesWritten += writer.getBytesWritten();
+
+    openRun(run, size);
+    if (runHeads.size() > maxRuns) {
+        mergeSmallestRuns();
+    }
+}
+
+// Merges the maxRuns / 2 + 1 smallest runs, the oldest first on ties, into a new run.
+// Fresh spills all have the same size, so merged runs grow geometrically and every
+// element is rewritten O(log(runs) / log(maxRuns)) times
+template <typename T>
+void ExternalHollowHeap<T>::mergeSmallestRuns() {
+    vector<int> inputs;
+    for (size_t run = 0; run < runs.size(); run++) {
+        if (runs[run].reader != nullptr) {
+            inputs.push_back(run);
+        }
+    }
+    sort(inputs.begin(), inputs.end(), [this](int a, int b) {
+        return tie(runs[a].size, runs[a].number) < tie(runs[b].size, runs[b].number);
+    });
+    inputs.resize(maxRuns / 2 + 1);
+
+    // the heads of the inputs move from runHeads to a heap of their own
+    HollowHeap<RunHead<T>> heads;
+    long long size = 0;
+    for (int run : inputs) {
+        runHeads.deleteItem(runs[run].head);
+        runs[run].head = nullptr;
+        heads.insert(RunHead<T>{runs[run].reader->peek(), run});
+        size += runs[run].size;
+    }
+
+    int merged = createRun();
+    RunWriter<T> writer(runs[merged].path, blockSize, true);
+    while (!heads.isEmpty()) {
+        int run = heads.getMin().run;
+        RunReader<T> &reader = *runs[run].reader;
+        long long bytesBefore = reader.getBytesRead();
+        writer.write(reader.next());
+        counters.bytesRead += reader.getBytesRead() - bytesBefore;
+        if (reader.isExhausted()) {
+            heads.extractMin();
+        } else {
+            heads.replaceMin(RunHead<T>{reader.peek(), run});
+        }
+    }
+    writer.close();
+    counters.bytesWritten += writer.getBytesWritten();
+
+    for (int run : inputs) {
+        closeRun(run);
+    }
+    openRun(merged, size);
+}
+
+// reserves a slot and a file name for a run that is about to be written
+template <typename T>
+int ExternalHollowHeap<T>::createRun() {
+    int run;
+    if (freeSlots.empty()) {
+        run = runs.size();
+        runs.emplace_back();
+    } else {
+        run = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    runs[run].number = runsWritten++;
+    runs[run].path = directory + "/hollow-heap-" + to_string(getpid()) + "-" + to_string(instance)
+            + "-run-" + to_string(runs[run].number) + ".bin";
+    return run;
+}
+
+// starts reading a written run of size elements and adds its head to runHeads
+template <typename T>
+void ExternalHollowHeap<T>::openRun(int run, long long size) {
+    runs[run].reader = unique_ptr<RunReader<T>>(new RunReader<T>(runs[run].path, blockSize));
+    runs[run].size = size;
+    counters.bytesRead += runs[run].reader->getBytesRead();
+    runs[run].head = runHeads.insert(RunHead<T>{runs[run].reader->peek(), run});
+}
+
+template <typename T>
+void ExternalHollowHeap<T>::closeRun(int run) {
+    runs[run].reader.reset();
+    runs[run].head = nullptr;
+    remove(runs[run].path.c_str());
+    freeSlots.push_back(run);
+}
+
+template <typename T>
+bool ExternalHollowHeap<T>::minIsOnDisk() {
+    if (runHeads.isEmpty()) {
+        return false;
+    }
+    return memory.isEmpty() || runHeads.getMin().key < memory.getMin();
+}
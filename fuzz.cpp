@@ -0,0 +1,215 @@
+// Differential fuzzing of HollowHeap against a std::multiset model.
+//
+// libFuzzer target:
+//   clang++ -std=c++17 -pthread -g -fsanitize=fuzzer,address,undefined -DHOLLOW_HEAP_LIBFUZZER fuzz.cpp
+// standalone randomized driver:
+//   g++ -std=c++17 -pthread -g -fsanitize=address,undefined fuzz.cpp -o fuzz && ./fuzz [iterations] [seed]
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <set>
+#include "hollow_heap.cpp"
+
+class OperationStream {
+public:
+    OperationStream(const uint8_t *data, size_t size): data(data), size(size) {}
+
+    bool isExhausted() {
+        return pos >= size;
+    }
+
+    uint8_t next() {
+        return isExhausted() ? 0 : data[pos++];
+    }
+
+    // keys come from a small range so that duplicates are common
+    int nextKey() {
+        return next() % 64;
+    }
+
+private:
+    const uint8_t *data;
+    size_t size;
+    size_t pos = 0;
+};
+
+void check(bool condition, const char *message) {
+    if (!condition) {
+        throw logic_error(message);
+    }
+}
+
+// removes and returns the handle at index by swapping it with the last one
+shared_ptr<Item<int>> takeHandle(vector<shared_ptr<Item<int>>> &handles, size_t index) {
+    shared_ptr<Item<int>> handle = handles[index];
+    handles[index] = handles.back();
+    handles.pop_back();
+    return handle;
+}
+
+// drops the handle that the heap has just extracted
+void forgetExtracted(vector<shared_ptr<Item<int>>> &handles) {
+    for (size_t i = 0; i < handles.size(); i++) {
+        if (!handles[i]->isInHeap()) {
+            takeHandle(handles, i);
+            return;
+        }
+    }
+    throw logic_error("extractMin did not remove any item");
+}
+
+void runOperations(const uint8_t *data, size_t size) {
+    OperationStream ops(data, size);
+    HollowHeap<int> heap;
+    multiset<int> model;
+    vector<shared_ptr<Item<int>>> handles;
+
+    // the first byte picks parallel consolidation and, one time in four, a capacity
+    uint8_t config = ops.next();
+    if (config % 2) {
+        heap.setParallelConsolidationThreshold(1);
+        heap.setParallelConsolidationThreads(2);
+    }
+    int capacity = (config / 2) % 4 == 0 ? 1 + (config / 8) % 16 : 0;
+    heap.setCapacity(capacity);
+
+    while (!ops.isExhausted()) {
+        switch (ops.next() % 8) {
+            case 0: { // insert
+                int key = ops.nextKey();
+                if (capacity > 0 && (int) model.size() >= capacity) {
+                    bool rejected = key <= *model.begin();
+                    shared_ptr<Item<int>> handle = heap.insert(key);
+                    check((handle == nullptr) == rejected, "a full heap did not evict exactly the minimum");
+                    if (rejected) break;
+                    model.erase(model.begin());
+                    forgetExtracted(handles);
+                    handles.push_back(handle);
+                    model.insert(key);
+                    break;
+                }
+                handles.push_back(heap.insert(key));
+                model.insert(key);
+                break;
+            }
+            case 1: { // merge with a freshly built heap
+                HollowHeap<int> other;
+                int inserts = ops.next() % 8;
+                for (int i = 0; i < inserts; i++) {
+                    int key = ops.nextKey();
+                    handles.push_back(other.insert(key));
+                    model.insert(key);
+                }
+                heap.merge(other);
+                while (capacity > 0 && (int) model.size() > capacity) {
+                    model.erase(model.begin());
+                    forgetExtracted(handles);
+                }
+                break;
+            }
+            case 2: { // decreaseKey
+                if (handles.empty()) break;
+                shared_ptr<Item<int>> &handle = handles[ops.next() % handles.size()];
+                int oldKey = handle->getValue();
+                int newKey = oldKey - ops.next() % 16;
+                model.erase(model.find(oldKey));
+                model.insert(newKey);
+                heap.decreaseKey(handle, newKey);
+                check(handle->getValue() == newKey, "decreaseKey did not update the item");
+                break;
+            }
+            case 3: { // deleteItem
+                if (handles.empty()) break;
+                shared_ptr<Item<int>> handle = takeHandle(handles, ops.next() % handles.size());
+                model.erase(model.find(handle->getValue()));
+                heap.deleteItem(handle);
+                check(!handle->isInHeap(), "deleteItem left the item in the heap");
+                break;
+            }
+            case 4: { // extractMin
+                if (model.empty()) break;
+                check(heap.extractMin() == *model.begin(), "extractMin returned a wrong key");
+                model.erase(model.begin());
+                forgetExtracted(handles);
+                break;
+            }
+            case 5: { // getMin
+                if (model.empty()) break;
+                check(heap.getMin() == *model.begin(), "getMin returned a wrong key");
+                break;
+            }
+            case 6: { // replaceMin
+                if (model.empty()) break;
+                int key = ops.nextKey();
+                check(heap.replaceMin(key) == *model.begin(), "replaceMin returned a wrong key");
+                model.erase(model.begin());
+                model.insert(key);
+                break;
+            }
+            case 7: { // updateKey
+                if (handles.empty()) break;
+                shared_ptr<Item<int>> &handle = handles[ops.next() % handles.size()];
+                int oldKey = handle->getValue();
+                int newKey = ops.nextKey();
+                model.erase(model.find(oldKey));
+                model.insert(newKey);
+                heap.updateKey(handle, newKey);
+                check(handle->getValue() == newKey, "updateKey did not update the item");
+                check(handle->isInHeap(), "updateKey removed the item from the heap");
+                break;
+            }
+        }
+
+        check(heap.size() == (int) model.size(), "size differs from the model");
+        check(heap.isEmpty() == model.empty(), "isEmpty differs from the model");
+        heap.checkInvariants();
+    }
+
+    while (!model.empty()) {
+        check(heap.extractMin() == *model.begin(), "extractMin returned a wrong key");
+        model.erase(model.begin());
+        heap.checkInvariants();
+    }
+    check(heap.isEmpty(), "the heap is not empty after draining the model");
+}
+
+#ifdef HOLLOW_HEAP_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    runOperations(data, size);
+    return 0;
+}
+
+#else
+
+int main(int argc, char **argv) {
+    long iterations = argc > 1 ? atol(argv[1]) : 2000;
+    unsigned seed = argc > 2 ? (unsigned) atol(argv[2]) : random_device{}();
+
+    mt19937 rng(seed);
+    uniform_int_distribution<size_t> sizes(0, 512);
+    uniform_int_distribution<int> bytes(0, 255);
+    vector<uint8_t> input;
+
+    for (long i = 0; i < iterations; i++) {
+        input.resize(sizes(rng));
+        for (uint8_t &byte : input) {
+            byte = (uint8_t) bytes(rng);
+        }
+
+        try {
+            runOperations(input.data(), input.size());
+        } catch (const exception &e) {
+            cerr << "iteration " << i << " (seed " << seed << ") failed: " << e.what() << endl;
+            return 1;
+        }
+    }
+
+    cout << iterations << " iterations passed (seed " << seed << ")" << endl;
+    return 0;
+}
+
+#endif
@@ -1,11 +1,17 @@
+#pragma once
+
 #include <vector>
 #include <cmath>
 #include <memory>
+#include <memory_resource>
 #include <stdexcept>
+#include <thread>
+#include <cstdint>
+#include <unordered_map>
 
 using namespace std;
 
-template <typename T>
+template <typename T, typename Alloc = allocator<T>>
 class HollowHeap;
 
 template <typename T>
@@ -23,8 +29,12 @@ public:
     T getValue() {
         return value;
     }
+    // false once the item has been extracted or deleted
+    bool isInHeap() {
+        return !node.expired();
+    }
 
-    friend class HollowHeap<T>;
+    template <typename, typename> friend class HollowHeap;
     friend class Node<T>;
 };
 
@@ -36,6 +46,9 @@ private:
     shared_ptr<Node<T>> next;
     shared_ptr<Node<T>> child;
     weak_ptr<Node<T>> extraParent;
+    // the node whose child list this node was added to last. Only meaningful
+    // for full nodes other than the minimum, which have exactly one parent
+    weak_ptr<Node<T>> parent;
     int rank = 0;
 public:
     explicit Node(shared_ptr<Item<T>> initItem) {
@@ -43,25 +56,67 @@ public:
         this->key = initItem->value;
     }
 
-    friend class HollowHeap<T>;
+    template <typename, typename> friend class HollowHeap;
 };
 
-template <typename T>
+// Alloc is used for nodes, items and the scratch space of deleteItem,
+// e.g. pmr::polymorphic_allocator<T> to take memory from a pmr::memory_resource
+template <typename T, typename Alloc>
 class HollowHeap {
 public:
+    HollowHeap() = default;
+    explicit HollowHeap(const Alloc &alloc);
+
     bool isEmpty();
     T getMin();
     int size();
     shared_ptr<Item<T>> insert(T el);
-    void merge(HollowHeap<T> &hh);
+    void merge(HollowHeap<T, Alloc> &hh);
     T extractMin();
+    T replaceMin(T val);
     void decreaseKey(shared_ptr<Item<T>> &itemToDecrease, T val);
+    void updateKey(shared_ptr<Item<T>> &itemToUpdate, T val);
     void deleteItem(shared_ptr<Item<T>> &itemToDelete);
+    void checkInvariants();
+    void setParallelConsolidationThreshold(int threshold);
+    void setParallelConsolidationThreads(int threads);
+    void setCapacity(int newCapacity);
+    int getCapacity();
+    long long getAvoidedAllocations();
+    long long getInPlaceDecreases();
+    long long getParallelConsolidations();
 private:
+    using RootListAllocator = typename allocator_traits<Alloc>::template rebind_alloc<shared_ptr<Node<T>>>;
+    using RootList = vector<shared_ptr<Node<T>>, RootListAllocator>;
+
     int count = 0;
     shared_ptr<Node<T>> min;
+    Alloc alloc;
+    // deleteItem links roots on several threads once it finds more than this many full roots
+    int parallelThreshold = 1 << 14;
+    // 0 means thread::hardware_concurrency()
+    int parallelThreads = 0;
+    long long parallelConsolidations = 0;
+    // 0 means unbounded. A full heap keeps the largest elements inserted so far
+    int capacity = 0;
+    // hollow roots destroyed by deleteItem, reused by makeNode
+    RootList freeNodes{RootListAllocator(alloc)};
+    // rank array of deleteItem. Every entry is null between calls, so it is reused as is
+    RootList fullRoots{RootListAllocator(alloc)};
+    long long avoidedAllocations = 0;
+    // decreaseKey calls that kept heap order without a new node
+    long long inPlaceDecreases = 0;
 
     shared_ptr<Node<T>> makeNode(shared_ptr<Item<T>> &item);
+    shared_ptr<Item<T>> evictMin(T el);
+    void trimToCapacity();
+    shared_ptr<Node<T>> detachMin();
+    bool hasChildSmallerThan(shared_ptr<Node<T>> &node, T val);
+    void reattach(
+            shared_ptr<Node<T>> &node,
+            shared_ptr<Item<T>> &item,
+            T val);
+    void recycleNode(shared_ptr<Node<T>> &node);
     shared_ptr<Node<T>> link(shared_ptr<Node<T>> &n1, shared_ptr<Node<T>> &n2);
     void addChild(
             shared_ptr<Node<T>> &futureChild,
@@ -70,8 +125,15 @@ private:
     shared_ptr<Node<T>> merge(shared_ptr<Node<T>> &newNode);
     int handleChildrenOfHollowRoot(
             shared_ptr<Node<T>> &hollowRoot,
-            vector<shared_ptr<Node<T>>>& fullRoots,
-            int maxRank);
+            RootList &fullRoots,
+            int maxRank,
+            int &roots,
+            RootList &overflow);
+
+    int consolidateInParallel(
+            RootList &fullRoots,
+            int maxRank,
+            RootList &overflow);
 
     shared_ptr<Node<T>> handleHollowChild(
             shared_ptr<Node<T>>& childOfHollowRoot,
@@ -79,13 +141,13 @@ private:
 
     void doUnrankedLinks(
             int maxRank,
-            vector<shared_ptr<Node<T>>> &fullRoots);
+            RootList &fullRoots);
 
-    void initFullRootsList(vector<shared_ptr<Node<T>>>& fullRoots);
+    void initFullRootsList(RootList &fullRoots);
     int doRankedLinks(
             shared_ptr<Node<T>> &node,
             int maxRank,
-            vector<shared_ptr<Node<T>>> &fullRoots);
+            RootList &fullRoots);
     bool equals(
             const weak_ptr<Node<T>>& weakPtr,
             const shared_ptr<Node<T>>& sharedPtr
@@ -93,7 +155,13 @@ private:
 };
 
 template <typename T>
-T HollowHeap<T>::getMin() {
+using PmrHollowHeap = HollowHeap<T, pmr::polymorphic_allocator<T>>;
+
+template <typename T, typename Alloc>
+HollowHeap<T, Alloc>::HollowHeap(const Alloc &alloc): alloc(alloc) {}
+
+template <typename T, typename Alloc>
+T HollowHeap<T, Alloc>::getMin() {
     if (min == nullptr) {
         throw logic_error("The heap is empty. Not able to get the minimum value");
     } else {
@@ -101,20 +169,28 @@ T HollowHeap<T>::getMin() {
     }
 }
 
-template <typename T>
-int HollowHeap<T>::size() {
+template <typename T, typename Alloc>
+int HollowHeap<T, Alloc>::size() {
     return count;
 }
 
-template <typename T>
-bool HollowHeap<T>::isEmpty() {
+template <typename T, typename Alloc>
+bool HollowHeap<T, Alloc>::isEmpty() {
     return count == 0;
 }
 
-// returns inserted item
-template <typename T>
-shared_ptr<Item<T>> HollowHeap<T>::insert(T el) {
-    shared_ptr<Item<T>> item(new Item<T>(el));
+// returns inserted item, or nullptr if the heap is at capacity
+// and el is not larger than the current minimum
+template <typename T, typename Alloc>
+shared_ptr<Item<T>> HollowHeap<T, Alloc>::insert(T el) {
+    if (capacity > 0 && count >= capacity) {
+        if (el <= min->key) {
+            return nullptr;
+        }
+        return evictMin(el);
+    }
+
+    shared_ptr<Item<T>> item = allocate_shared<Item<T>>(alloc, el);
     shared_ptr<Node<T>> newNode = makeNode(item);
 
     shared_ptr<Node<T>> newMin = merge(newNode);
@@ -124,23 +200,103 @@ shared_ptr<Item<T>> HollowHeap<T>::insert(T el) {
     return newNode->item;
 }
 
-template <typename T>
-void HollowHeap<T>::merge(HollowHeap<T> &hh) {
+// extracts the minimum and reuses its node, and its item if nobody else holds it, for el
+template <typename T, typename Alloc>
+shared_ptr<Item<T>> HollowHeap<T, Alloc>::evictMin(T el) {
+    shared_ptr<Item<T>> item = min->item;
+    shared_ptr<Node<T>> node = detachMin();
+
+    avoidedAllocations++;
+    if (item.use_count() == 1) {
+        avoidedAllocations++;
+    } else {
+        item = allocate_shared<Item<T>>(alloc, el);
+    }
+
+    reattach(node, item, el);
+    return item;
+}
+
+// removes the minimum item and returns its node, no longer linked to anything
+template <typename T, typename Alloc>
+shared_ptr<Node<T>> HollowHeap<T, Alloc>::detachMin() {
+    shared_ptr<Node<T>> node = min;
+    shared_ptr<Item<T>> item = node->item;
+    deleteItem(item);
+
+    // the node was a hollow root, consolidation has moved all its children away
+    node->child = nullptr;
+    node->next = nullptr;
+    node->rank = 0;
+    return node;
+}
+
+// links a node returned by detachMin back into the heap as item with key val
+template <typename T, typename Alloc>
+void HollowHeap<T, Alloc>::reattach(
+        shared_ptr<Node<T>> &node,
+        shared_ptr<Item<T>> &item,
+        T val
+) {
+    item->value = val;
+    item->node = node;
+    node->key = val;
+    node->item = item;
+
+    min = merge(node);
+    count++;
+}
+
+// replaces the minimum by val and returns the old minimum.
+// The item handle and the node are reused, and at most one consolidation is done.
+// If val is still no larger than any child of the minimum, the key is updated in place
+template <typename T, typename Alloc>
+T HollowHeap<T, Alloc>::replaceMin(T val) {
+    T minVal = getMin();
+    if (val <= minVal || !hasChildSmallerThan(min, val)) {
+        min->key = val;
+        min->item->value = val;
+        return minVal;
+    }
+
+    shared_ptr<Item<T>> item = min->item;
+    shared_ptr<Node<T>> node = detachMin();
+    reattach(node, item, val);
+    return minVal;
+}
+
+template <typename T, typename Alloc>
+bool HollowHeap<T, Alloc>::hasChildSmallerThan(shared_ptr<Node<T>> &node, T val) {
+    for (shared_ptr<Node<T>> child = node->child; child != nullptr; child = child->next) {
+        if (child->key < val) {
+            return true;
+        }
+        // the rest of the list belongs to the other parent of child
+        if (equals(child->extraParent, node)) {
+            break;
+        }
+    }
+    return false;
+}
+
+template <typename T, typename Alloc>
+void HollowHeap<T, Alloc>::merge(HollowHeap<T, Alloc> &hh) {
     shared_ptr<Node<T>> newMin = merge(hh.min);
     count = count + hh.count;
 
     min = newMin;
+    trimToCapacity();
 }
 
-template <typename T>
-T HollowHeap<T>::extractMin() {
+template <typename T, typename Alloc>
+T HollowHeap<T, Alloc>::extractMin() {
     T minVal = min->key;
     deleteItem(min->item);
     return minVal;
 }
 
-template <typename T>
-void HollowHeap<T>::decreaseKey(shared_ptr<Item<T>> &itemToDecrease, T val) {
+template <typename T, typename Alloc>
+void HollowHeap<T, Alloc>::decreaseKey(shared_ptr<Item<T>> &itemToDecrease, T val) {
     shared_ptr<Node<T>> nodeToDecrease = itemToDecrease->node.lock();
     itemToDecrease->value = val;
 
@@ -148,6 +304,13 @@ void HollowHeap<T>::decreaseKey(shared_ptr<Item<T>> &itemToDecrease, T val) {
         nodeToDecrease->key = val;
         return;
     }
+    // the minimum is the only root, so every other full node has a single parent
+    shared_ptr<Node<T>> parent = nodeToDecrease->parent.lock();
+    if (parent != nullptr && val >= parent->key) {
+        nodeToDecrease->key = val;
+        inPlaceDecreases++;
+        return;
+    }
 
     shared_ptr<Node<T>> secondParent = makeNode(itemToDecrease);
     secondParent->child = nodeToDecrease;
@@ -160,8 +323,41 @@ void HollowHeap<T>::decreaseKey(shared_ptr<Item<T>> &itemToDecrease, T val) {
     min = link(secondParent, min);
 }
 
-template <typename T>
-void HollowHeap<T>::deleteItem(shared_ptr<Item<T>> &itemToDelete) {
+// sets the key of the item to val in either direction, the item handle stays valid.
+// An increase is done in place when no child gets smaller than val, by replaceMin for
+// the minimum, and otherwise by leaving a hollow node behind and linking a new node
+// for the item, without any consolidation
+template <typename T, typename Alloc>
+void HollowHeap<T, Alloc>::updateKey(shared_ptr<Item<T>> &itemToUpdate, T val) {
+    shared_ptr<Node<T>> nodeToUpdate = itemToUpdate->node.lock();
+    if (nodeToUpdate == nullptr) {
+        throw logic_error("The item is not in the heap. Not able to update its key");
+    }
+    if (val == itemToUpdate->value) {
+        return;
+    }
+    if (val < itemToUpdate->value) {
+        decreaseKey(itemToUpdate, val);
+        return;
+    }
+    if (nodeToUpdate == min) {
+        replaceMin(val);
+        return;
+    }
+
+    itemToUpdate->value = val;
+    if (!hasChildSmallerThan(nodeToUpdate, val)) {
+        nodeToUpdate->key = val;
+        return;
+    }
+
+    nodeToUpdate->item = nullptr;
+    shared_ptr<Node<T>> newNode = makeNode(itemToUpdate);
+    min = merge(newNode);
+}
+
+template <typename T, typename Alloc>
+void HollowHeap<T, Alloc>::deleteItem(shared_ptr<Item<T>> &itemToDelete) {
     shared_ptr<Node<T>> nodeToDelete = itemToDelete->node.lock();
     nodeToDelete->item->node.reset();
     nodeToDelete->item.reset();
@@ -171,11 +367,17 @@ void HollowHeap<T>::deleteItem(shared_ptr<Item<T>> &itemToDelete) {
         count--;
         return;
     }
+    // drop the extra reference so that the old minimum can be recycled
+    nodeToDelete.reset();
 
     int maxRank = 0;
-    vector<shared_ptr<Node<T>>> fullRoots;
     initFullRootsList(fullRoots);
 
+    // the first parallelThreshold full roots are linked right away,
+    // the ones after them are left to consolidateInParallel
+    int roots = 0;
+    RootList overflow{RootListAllocator(alloc)};
+
     // iterate through all hollow roots and destroy them
     while (min != nullptr) { // while there are still hollow roots
         shared_ptr<Node<T>> hollowRoot = min;
@@ -184,31 +386,38 @@ void HollowHeap<T>::deleteItem(shared_ptr<Item<T>> &itemToDelete) {
         maxRank = handleChildrenOfHollowRoot(
                 hollowRoot,
                 fullRoots,
-                maxRank
+                maxRank,
+                roots,
+                overflow
         );
 
-        hollowRoot.reset();
+        recycleNode(hollowRoot);
+    }
+    if (!overflow.empty()) {
+        maxRank = consolidateInParallel(fullRoots, maxRank, overflow);
     }
 
     doUnrankedLinks(maxRank, fullRoots);
     count--;
 }
 
-template <typename T>
-void HollowHeap<T>::initFullRootsList(
-        vector<shared_ptr<Node<T>>> &fullRoots
+template <typename T, typename Alloc>
+void HollowHeap<T, Alloc>::initFullRootsList(
+        RootList &fullRoots
 ) {
-    fullRoots.resize(log2(count) + 1);
-    for (int i = 0; i < fullRoots.size(); i++) {
-        fullRoots[i] = nullptr;
+    // only grows, doUnrankedLinks leaves every entry null
+    if (fullRoots.size() < (size_t) log2(count) + 1) {
+        fullRoots.resize(log2(count) + 1);
     }
 }
 
-template <typename  T>
-int HollowHeap<T>::handleChildrenOfHollowRoot(
+template <typename T, typename Alloc>
+int HollowHeap<T, Alloc>::handleChildrenOfHollowRoot(
         shared_ptr<Node<T>> &hollowRoot,
-        vector<shared_ptr<Node<T>>> &fullRoots,
-        int maxRank
+        RootList &fullRoots,
+        int maxRank,
+        int &roots,
+        RootList &overflow
 ) {
     shared_ptr<Node<T>> nextChildOfHollowRoot = hollowRoot->child;
     while (nextChildOfHollowRoot != nullptr) {
@@ -224,19 +433,119 @@ int HollowHeap<T>::handleChildrenOfHollowRoot(
             // if child is not hollow, it will become a root after destruction of its (hollow) parent
             // Hence, add it to the list of full roots
             nextChildOfHollowRoot = childOfHollowRoot->next;
-            maxRank = doRankedLinks(
-                    childOfHollowRoot,
-                    maxRank,
-                    fullRoots
-            );
+            if (roots < parallelThreshold) {
+                maxRank = doRankedLinks(
+                        childOfHollowRoot,
+                        maxRank,
+                        fullRoots
+                );
+            } else {
+                overflow.push_back(move(childOfHollowRoot));
+            }
+            roots++;
         }
     }
     return maxRank;
 }
 
+// links the full roots that the hollow-root walk found after its first parallelThreshold.
+// Every thread does ranked links on its share of them in its own rank array, the first
+// one starting from the roots already in fullRoots, then the arrays are merged pairwise
+// in a tree reduction. Every root belongs to exactly one thread. Once the calling thread
+// has dropped the roots' links to their old siblings and parents, linking on a worker
+// neither allocates nor frees anything through alloc, so no locking is needed.
+// returns maxRank found in fullRoots array
+template <typename T, typename Alloc>
+int HollowHeap<T, Alloc>::consolidateInParallel(
+        RootList &fullRoots,
+        int maxRank,
+        RootList &overflow
+) {
+    // hardware_concurrency is 1 on a single CPU and 0 when unknown, threads would only cost there
+    size_t threads = parallelThreads > 0 ? parallelThreads : thread::hardware_concurrency();
+    threads = std::min(threads, overflow.size());
+    if (threads < 2) {
+        for (shared_ptr<Node<T>> &node : overflow) {
+            maxRank = doRankedLinks(node, maxRank, fullRoots);
+        }
+        return maxRank;
+    }
+    parallelConsolidations++;
+
+    // ranked links of k roots raise the largest rank by at most log2(k). Arrays of this
+    // size never grow on a worker thread, where alloc may not be used concurrently
+    int rankBound = maxRank;
+    for (shared_ptr<Node<T>> &node : overflow) {
+        rankBound = max(rankBound, node->rank);
+    }
+
+    // a stale next may hold the last reference to a destroyed hollow node, and a stale
+    // parent the last one to a control block. link would drop them on a worker thread
+    for (shared_ptr<Node<T>> &node : overflow) {
+        node->next = nullptr;
+        node->parent.reset();
+    }
+    for (shared_ptr<Node<T>> &node : fullRoots) {
+        if (node != nullptr) {
+            node->next = nullptr;
+            node->parent.reset();
+        }
+    }
+    rankBound += (int) log2(overflow.size() + maxRank + 1) + 1;
+    fullRoots.resize(rankBound + 1);
+
+    // built from alloc explicitly, copies of a RootList would not keep a pmr resource
+    using RankArraysAllocator = typename allocator_traits<Alloc>::template rebind_alloc<RootList>;
+    using RanksAllocator = typename allocator_traits<Alloc>::template rebind_alloc<int>;
+    vector<RootList, RankArraysAllocator> rankArrays{RankArraysAllocator(alloc)};
+    rankArrays.reserve(threads);
+    rankArrays.push_back(move(fullRoots));
+    for (size_t t = 1; t < threads; t++) {
+        rankArrays.push_back(RootList(rankBound + 1, nullptr, RootListAllocator(alloc)));
+    }
+    vector<int, RanksAllocator> maxRanks(threads, 0, RanksAllocator(alloc));
+    maxRanks[0] = maxRank;
+    vector<thread> workers;
+    size_t chunk = (overflow.size() + threads - 1) / threads;
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            size_t end = std::min(overflow.size(), (t + 1) * chunk);
+            for (size_t i = t * chunk; i < end; i++) {
+                maxRanks[t] = doRankedLinks(overflow[i], maxRanks[t], rankArrays[t]);
+            }
+        });
+    }
+    for (thread &worker : workers) {
+        worker.join();
+    }
+
+    // at every level, rank array t absorbs rank array t + step
+    for (size_t step = 1; step < threads; step *= 2) {
+        workers.clear();
+        for (size_t t = 0; t + step < threads; t += 2 * step) {
+            workers.emplace_back([&, t, step]() {
+                RootList &source = rankArrays[t + step];
+                for (int rank = 0; rank <= maxRanks[t + step]; rank++) {
+                    shared_ptr<Node<T>> node = source[rank];
+                    if (node != nullptr) {
+                        source[rank] = nullptr;
+                        maxRanks[t] = doRankedLinks(node, maxRanks[t], rankArrays[t]);
+                    }
+                }
+            });
+        }
+        for (thread &worker : workers) {
+            worker.join();
+        }
+    }
+
+    fullRoots = move(rankArrays[0]);
+    return maxRanks[0];
+}
+
 // returns next child of the hollow root to be processed
-template <typename  T>
-shared_ptr<Node<T>> HollowHeap<T>::handleHollowChild(
+template <typename T, typename Alloc>
+shared_ptr<Node<T>> HollowHeap<T, Alloc>::handleHollowChild(
         shared_ptr<Node<T>> &childOfHollowRoot,
         shared_ptr<Node<T>> &hollowRoot
 ) {
@@ -257,27 +566,32 @@ shared_ptr<Node<T>> HollowHeap<T>::handleHollowChild(
 }
 
 // returns maxRank found so far in fullRoots array
-template <typename T>
-int HollowHeap<T>::doRankedLinks(
+template <typename T, typename Alloc>
+int HollowHeap<T, Alloc>::doRankedLinks(
         shared_ptr<Node<T>> &node,
         int maxRank,
-        vector<shared_ptr<Node<T>>> &fullRoots
+        RootList &fullRoots
 ) {
-    while (fullRoots[node->rank] != nullptr) {
+    // ranks are bounded by log_phi of the number of nodes (hollow ones included),
+    // so the initial log2(count) estimate may be too small
+    while (fullRoots.size() > (size_t) node->rank && fullRoots[node->rank] != nullptr) {
         node = link(node, fullRoots[node->rank]);
         fullRoots[node->rank] = nullptr;
         node->rank += 1;
     }
+    if (fullRoots.size() <= (size_t) node->rank) {
+        fullRoots.resize(node->rank + 1);
+    }
     fullRoots[node->rank] = node;
     maxRank = max(maxRank, node->rank);
 
     return maxRank;
 }
 
-template <typename T>
-void HollowHeap<T>::doUnrankedLinks(
+template <typename T, typename Alloc>
+void HollowHeap<T, Alloc>::doUnrankedLinks(
         int maxRank,
-        vector<shared_ptr<Node<T>>> &fullRoots
+        RootList &fullRoots
 ) {
     for (int i = 0; i <= maxRank; i++) {
         if (fullRoots[i] != nullptr) {
@@ -292,8 +606,56 @@ void HollowHeap<T>::doUnrankedLinks(
     }
 }
 
-template <typename T>
-shared_ptr<Node<T>> HollowHeap<T>::merge(shared_ptr<Node<T>> &newNode) {
+template <typename T, typename Alloc>
+void HollowHeap<T, Alloc>::setParallelConsolidationThreshold(int threshold) {
+    parallelThreshold = threshold;
+}
+
+// 0 uses thread::hardware_concurrency(). Tests set it to run the threads on any host
+template <typename T, typename Alloc>
+void HollowHeap<T, Alloc>::setParallelConsolidationThreads(int threads) {
+    parallelThreads = threads;
+}
+
+// a heap larger than the new capacity drops its smallest elements
+template <typename T, typename Alloc>
+void HollowHeap<T, Alloc>::setCapacity(int newCapacity) {
+    capacity = newCapacity;
+    trimToCapacity();
+}
+
+// insert only keeps the size, so a heap that grew past capacity otherwise would never shrink
+template <typename T, typename Alloc>
+void HollowHeap<T, Alloc>::trimToCapacity() {
+    while (capacity > 0 && count > capacity) {
+        extractMin();
+    }
+}
+
+template <typename T, typename Alloc>
+int HollowHeap<T, Alloc>::getCapacity() {
+    return capacity;
+}
+
+// nodes and items reused instead of allocated, by makeNode and by evictions of a bounded heap
+template <typename T, typename Alloc>
+long long HollowHeap<T, Alloc>::getAvoidedAllocations() {
+    return avoidedAllocations;
+}
+
+// decreases that only changed the key, because the node's parent is still not larger
+template <typename T, typename Alloc>
+long long HollowHeap<T, Alloc>::getInPlaceDecreases() {
+    return inPlaceDecreases;
+}
+
+template <typename T, typename Alloc>
+long long HollowHeap<T, Alloc>::getParallelConsolidations() {
+    return parallelConsolidations;
+}
+
+template <typename T, typename Alloc>
+shared_ptr<Node<T>> HollowHeap<T, Alloc>::merge(shared_ptr<Node<T>> &newNode) {
     if (min == nullptr) {
         min = newNode;
         return min;
@@ -306,15 +668,39 @@ shared_ptr<Node<T>> HollowHeap<T>::merge(shared_ptr<Node<T>> &newNode) {
     return link(min, newNode);
 }
 
-template <typename T>
-shared_ptr<Node<T>> HollowHeap<T>::makeNode(shared_ptr<Item<T>> &item) {
-    shared_ptr<Node<T>> myNode(new Node<T>(item));
+template <typename T, typename Alloc>
+shared_ptr<Node<T>> HollowHeap<T, Alloc>::makeNode(shared_ptr<Item<T>> &item) {
+    shared_ptr<Node<T>> myNode;
+    if (freeNodes.empty()) {
+        myNode = allocate_shared<Node<T>>(alloc, item);
+    } else {
+        myNode = freeNodes.back();
+        freeNodes.pop_back();
+        myNode->key = item->value;
+        myNode->item = item;
+        avoidedAllocations++;
+    }
     item->node = myNode->shared_from_this();
     return myNode;
 }
 
-template <typename T>
-shared_ptr<Node<T>> HollowHeap<T>::link(
+// keeps a destroyed hollow root for makeNode if nothing else refers to it.
+// At most size() nodes are kept, so the free list never outgrows the heap
+template <typename T, typename Alloc>
+void HollowHeap<T, Alloc>::recycleNode(shared_ptr<Node<T>> &node) {
+    if (node.use_count() == 1 && freeNodes.size() < (size_t) count) {
+        node->child = nullptr;
+        node->next = nullptr;
+        node->extraParent.reset();
+        node->parent.reset();
+        node->rank = 0;
+        freeNodes.push_back(node);
+    }
+    node.reset();
+}
+
+template <typename T, typename Alloc>
+shared_ptr<Node<T>> HollowHeap<T, Alloc>::link(
         shared_ptr<Node<T>> &n1,
         shared_ptr<Node<T>> &n2
 ) {
@@ -327,21 +713,166 @@ shared_ptr<Node<T>> HollowHeap<T>::link(
     }
 }
 
-template <typename T>
-void HollowHeap<T>::addChild(
+template <typename T, typename Alloc>
+void HollowHeap<T, Alloc>::addChild(
         shared_ptr<Node<T>> &futureChild,
         shared_ptr<Node<T>> &futureParent
 ) {
     futureChild->next = futureParent->child;
+    futureChild->parent = futureParent;
     futureParent->child = futureChild;
     // a root does not have a parent and therefore no next link
     futureParent->next = nullptr;
 }
 
-template <typename T>
-bool HollowHeap<T>::equals(
+template <typename T, typename Alloc>
+bool HollowHeap<T, Alloc>::equals(
         const weak_ptr<Node<T>>& weakPtr,
         const shared_ptr<Node<T>>& sharedPtr
 ) {
     return !weakPtr.expired() && weakPtr.lock() == sharedPtr;
-}
\ No newline at end of file
+}
+
+// walks every node reachable from min and throws logic_error on the first
+// violated invariant. Meant for tests and fuzzing: it takes O(n^2 / 64) time and memory
+template <typename T, typename Alloc>
+void HollowHeap<T, Alloc>::checkInvariants() {
+    if (min == nullptr) {
+        if (count != 0) {
+            throw logic_error("The heap has no root but its size is not 0");
+        }
+        return;
+    }
+    if (min->item == nullptr) {
+        throw logic_error("The minimum node is hollow");
+    }
+
+    // index every reachable node and remember the child lists by index
+    unordered_map<Node<T>*, int> index;
+    vector<Node<T>*> nodes;
+    vector<vector<int>> children;
+    vector<int> toVisit;
+    auto discover = [&](Node<T>* node) {
+        auto inserted = index.emplace(node, (int) nodes.size());
+        if (inserted.second) {
+            nodes.push_back(node);
+            children.emplace_back();
+            toVisit.push_back(inserted.first->second);
+        }
+        return inserted.first->second;
+    };
+
+    for (shared_ptr<Node<T>> root = min; root != nullptr; root = root->next) {
+        if (root->key < min->key) {
+            throw logic_error("A root has a smaller key than the minimum node");
+        }
+        if (root->extraParent.lock()) {
+            throw logic_error("A root has an extra parent");
+        }
+        discover(root.get());
+    }
+
+    int fullNodes = 0;
+    while (!toVisit.empty()) {
+        int nodeIndex = toVisit.back();
+        toVisit.pop_back();
+        Node<T>* node = nodes[nodeIndex];
+
+        if (node->item != nullptr) {
+            fullNodes++;
+            if (node->item->node.lock().get() != node) {
+                throw logic_error("A full node and its item do not point to each other");
+            }
+        }
+
+        // a child reached through its extra parent is the last child in that list,
+        // its next link belongs to the child list of its other parent
+        for (shared_ptr<Node<T>> child = node->child; child != nullptr; child = child->next) {
+            if (child->key < node->key) {
+                throw logic_error("Heap order is violated");
+            }
+            if (child->item != nullptr && child->parent.lock().get() != node) {
+                throw logic_error("A full node does not point to its parent");
+            }
+            int childIndex = discover(child.get());
+            children[nodeIndex].push_back(childIndex);
+            if (child->extraParent.lock().get() == node) {
+                break;
+            }
+        }
+    }
+
+    vector<int> parentCount(nodes.size(), 0);
+    for (const vector<int> &childList : children) {
+        for (int child : childList) {
+            parentCount[child]++;
+        }
+    }
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (parentCount[i] > 2) {
+            throw logic_error("A node has more than two parents");
+        }
+        if ((parentCount[i] == 2) != (bool) nodes[i]->extraParent.lock()) {
+            throw logic_error("The extra parent link does not match the number of parents");
+        }
+        if (parentCount[i] == 2 && nodes[i]->item != nullptr) {
+            throw logic_error("A full node has two parents");
+        }
+    }
+
+    if (fullNodes != count) {
+        throw logic_error("The number of full nodes does not match the heap size");
+    }
+
+    // a node of rank r has at least F(r + 3) - 1 descendants, counting the node itself.
+    // Descendant sets are bitsets built in post-order, children before parents
+    size_t words = (nodes.size() + 63) / 64;
+    vector<vector<uint64_t>> descendants(nodes.size());
+    vector<pair<int, bool>> stack;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        stack.emplace_back(i, false);
+        while (!stack.empty()) {
+            pair<int, bool> top = stack.back();
+            stack.pop_back();
+            int nodeIndex = top.first;
+            if (!descendants[nodeIndex].empty()) {
+                continue;
+            }
+            if (!top.second) {
+                stack.emplace_back(nodeIndex, true);
+                for (int child : children[nodeIndex]) {
+                    stack.emplace_back(child, false);
+                }
+                continue;
+            }
+
+            vector<uint64_t> &below = descendants[nodeIndex];
+            below.assign(words, 0);
+            below[nodeIndex / 64] |= uint64_t(1) << (nodeIndex % 64);
+            for (int child : children[nodeIndex]) {
+                for (size_t w = 0; w < words; w++) {
+                    below[w] |= descendants[child][w];
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (0 > nodes[i]->rank) {
+            throw logic_error("A node has a negative rank");
+        }
+        long long prev = 1, curr = 2; // F(2), F(3)
+        for (int r = 0; r < nodes[i]->rank; r++) {
+            long long nextFib = prev + curr;
+            prev = curr;
+            curr = nextFib;
+        }
+        long long descendantCount = 0;
+        for (uint64_t word : descendants[i]) {
+            descendantCount += __builtin_popcountll(word);
+        }
+        if (descendantCount < curr - 1) {
+            throw logic_error("A node has too few descendants for its rank");
+        }
+    }
+}
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <unistd.h>
+#include "hollow_heap.cpp"
+#include "run_file.cpp"
+
+using namespace std;
+
+struct MergeStats {
+    long long bytesRead = 0;
+    long long bytesWritten = 0;
+    double seconds = 0;
+
+    double megabytesPerSecond() {
+        return seconds > 0 ? bytesRead / (1024.0 * 1024.0) / seconds : 0;
+    }
+};
+
+// Streams the merge of sorted run files of T.
+// The heap holds one entry per non-empty run, keyed on the run's head. Consuming a head
+// advances its run with replaceMin, so the entry's node and item are reused instead of
+// being extracted and inserted again.
+// Every open run keeps a file and two blocks of blockSize bytes, so at most maxRuns runs
+// are open at a time. With more inputs, the smallest runs are first merged into
+// intermediate runs in directory, which are removed once they are read
+template <typename T>
+class KWayMerger {
+public:
+    explicit KWayMerger(
+            const vector<string> &inputs,
+            size_t blockSize = 1 << 20,
+            int maxRuns = 64,
+            const string &directory = filesystem::temp_directory_path().string());
+    ~KWayMerger();
+    KWayMerger(const KWayMerger &) = delete;
+    KWayMerger &operator=(const KWayMerger &) = delete;
+
+    bool isExhausted();
+    T next();
+    long long getBytesRead();
+    long long getBytesWritten();
+private:
+    struct PendingRun {
+        string path;
+        long long size = 0;
+        // runs are numbered in the order they were written, inputs first
+        long long number = 0;
+        bool intermediate = false;
+    };
+
+    vector<unique_ptr<RunReader<T>>> runs;
+    // paths of the open intermediate runs, empty for inputs
+    vector<string> intermediatePaths;
+    HollowHeap<RunHead<T>> heads;
+    long long bytesRead = 0;
+    // bytes of intermediate runs
+    long long bytesWritten = 0;
+    int instance;
+    long long runsWritten = 0;
+
+    void mergeSmallestRuns(
+            vector<PendingRun> &pending,
+            size_t blockSize,
+            int maxRuns,
+            const string &directory);
+    void closeRun(int run);
+};
+
+template <typename T>
+KWayMerger<T>::KWayMerger(
+        const vector<string> &inputs,
+        size_t blockSize,
+        int maxRuns,
+        const string &directory
+) {
+    if (maxRuns < 2) {
+        throw logic_error("At least 2 runs are needed to merge them. Not able to create the merger");
+    }
+    static atomic<int> instances(0);
+    instance = instances++;
+
+    vector<PendingRun> pending;
+    for (const string &path : inputs) {
+        // a missing input counts as empty here, RunReader reports it when it is opened
+        error_code error;
+        uintmax_t size = filesystem::file_size(path, error);
+        pending.push_back(PendingRun{path, error ? 0 : (long long) size, runsWritten++, false});
+    }
+    try {
+        while (pending.size() > (size_t) maxRuns) {
+            mergeSmallestRuns(pending, blockSize, maxRuns, directory);
+        }
+    } catch (...) {
+        for (PendingRun &run : pending) {
+            if (run.intermediate) {
+                remove(run.path.c_str());
+            }
+        }
+        throw;
+    }
+
+    for (PendingRun &pendingRun : pending) {
+        int run = runs.size();
+        runs.push_back(unique_ptr<RunReader<T>>(new RunReader<T>(pendingRun.path, blockSize)));
+        intermediatePaths.push_back(pendingRun.intermediate ? pendingRun.path : "");
+        bytesRead += runs[run]->getBytesRead();
+        if (runs[run]->isExhausted()) {
+            closeRun(run);
+        } else {
+            heads.insert(RunHead<T>{runs[run]->peek(), run});
+        }
+    }
+}
+
+template <typename T>
+KWayMerger<T>::~KWayMerger() {
+    for (size_t run = 0; run < runs.size(); run++) {
+        closeRun(run);
+    }
+}
+
+template <typename T>
+bool KWayMerger<T>::isExhausted() {
+    return heads.isEmpty();
+}
+
+template <typename T>
+T KWayMerger<T>::next() {
+    if (isExhausted()) {
+        throw logic_error("All runs are exhausted. Not able to read the next value");
+    }
+
+    int run = heads.getMin().run;
+    RunReader<T> &reader = *runs[run];
+    long long bytesBefore = reader.getBytesRead();
+    T minVal = reader.next();
+    bytesRead += reader.getBytesRead() - bytesBefore;
+    if (reader.isExhausted()) {
+        heads.extractMin();
+        closeRun(run);
+    } else {
+        heads.replaceMin(RunHead<T>{reader.peek(), run});
+    }
+    return minVal;
+}
+
+// includes the bytes read from intermediate runs
+template <typename T>
+long long KWayMerger<T>::getBytesRead() {
+    return bytesRead;
+}
+
+template <typename T>
+long long KWayMerger<T>::getBytesWritten() {
+    return bytesWritten;
+}
+
+// Merges the smallest runs, the oldest first on ties, into an intermediate run. It takes
+// just enough of them that the remaining runs fit into maxRuns, at most maxRuns. Merged
+// runs grow geometrically, so every element is rewritten O(log(runs) / log(maxRuns)) times
+template <typename T>
+void KWayMerger<T>::mergeSmallestRuns(
+        vector<PendingRun> &pending,
+        size_t blockSize,
+        int maxRuns,
+        const string &directory
+) {
+    sort(pending.begin(), pending.end(), [](const PendingRun &a, const PendingRun &b) {
+        return tie(a.size, a.number) < tie(b.size, b.number);
+    });
+    size_t inputCount = std::min(pending.size() - maxRuns + 1, (size_t) maxRuns);
+    vector<string> inputs;
+    for (size_t i = 0; i < inputCount; i++) {
+        inputs.push_back(pending[i].path);
+    }
+
+    PendingRun merged;
+    merged.path = directory + "/kway-merge-" + to_string(getpid()) + "-" + to_string(instance)
+            + "-run-" + to_string(runsWritten) + ".bin";
+    merged.number = runsWritten++;
+    merged.intermediate = true;
+    {
+        KWayMerger<T> merger(inputs, blockSize, maxRuns, directory);
+        RunWriter<T> writer(merged.path, blockSize, true);
+        // the run is written, so from here on it is removed on failure
+        pending.push_back(merged);
+        while (!merger.isExhausted()) {
+            writer.write(merger.next());
+        }
+        writer.close();
+        bytesRead += merger.getBytesRead();
+        bytesWritten += writer.getBytesWritten();
+        pending.back().size = writer.getBytesWritten();
+    }
+
+    for (size_t i = 0; i < inputCount; i++) {
+        if (pending[i].intermediate) {
+            remove(pending[i].path.c_str());
+        }
+    }
+    pending.erase(pending.begin(), pending.begin() + inputCount);
+}
+
+template <typename T>
+void KWayMerger<T>::closeRun(int run) {
+    runs[run].reset();
+    if (!intermediatePaths[run].empty()) {
+        remove(intermediatePaths[run].c_str());
+        intermediatePaths[run].clear();
+    }
+}
+
+// Merges sorted run files of T into output and reports the throughput.
+// Intermediate runs are written next to output
+template <typename T>
+MergeStats kwayMerge(
+        const vector<string> &inputs,
+        const string &output,
+        size_t blockSize = 1 << 20,
+        int maxRuns = 64
+) {
+    auto start = chrono::steady_clock::now();
+    string directory = filesystem::path(output).parent_path().string();
+    KWayMerger<T> merger(inputs, blockSize, maxRuns, directory.empty() ? "." : directory);
+    RunWriter<T> writer(output, blockSize);
+    while (!merger.isExhausted()) {
+        writer.write(merger.next());
+    }
+    writer.close();
+
+    MergeStats stats;
+    stats.bytesRead = merger.getBytesRead();
+    stats.bytesWritten = merger.getBytesWritten() + writer.getBytesWritten();
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return stats;
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+template <typename T>
+class PersistentHollowHeap;
+
+template <typename T>
+struct PersistentNode {
+private:
+    T key;
+    shared_ptr<PersistentNode<T>> next;
+    shared_ptr<PersistentNode<T>> child;
+    int rank = 0;
+public:
+    explicit PersistentNode(T key) {
+        this->key = key;
+    }
+
+    friend class PersistentHollowHeap<T>;
+};
+
+// Hollow heap whose copies share structure, for callers that fork a queue many times.
+// clone() is O(1). A node is changed in place only while the heap holds the only
+// reference to it; otherwise link copies it first, so copying is limited to the nodes
+// a link touches and the other heaps never see the change. merge leaves the other heap
+// valid too. There are no item handles: a handle would name a node shared by all forks,
+// so only insert, merge and extractMin are supported.
+// Amortization does not carry over between forks: a consolidation that is still due
+// when the heap is cloned, e.g. right after many inserts, is paid again by every fork
+template <typename T>
+class PersistentHollowHeap {
+public:
+    bool isEmpty();
+    T getMin();
+    int size();
+    void insert(T el);
+    void merge(PersistentHollowHeap<T> &hh);
+    T extractMin();
+    PersistentHollowHeap<T> clone();
+    long long getCopiedNodes();
+private:
+    int count = 0;
+    shared_ptr<PersistentNode<T>> min;
+    // nodes copied because another heap still referred to them
+    long long copiedNodes = 0;
+
+    void makeWritable(shared_ptr<PersistentNode<T>> &node);
+    shared_ptr<PersistentNode<T>> link(
+            shared_ptr<PersistentNode<T>> &n1,
+            shared_ptr<PersistentNode<T>> &n2);
+    int doRankedLinks(
+            shared_ptr<PersistentNode<T>> &node,
+            int maxRank,
+            vector<shared_ptr<PersistentNode<T>>> &fullRoots);
+};
+
+template <typename T>
+bool PersistentHollowHeap<T>::isEmpty() {
+    return count == 0;
+}
+
+template <typename T>
+T PersistentHollowHeap<T>::getMin() {
+    if (min == nullptr) {
+        throw logic_error("The heap is empty. Not able to get the minimum value");
+    }
+    return min->key;
+}
+
+template <typename T>
+int PersistentHollowHeap<T>::size() {
+    return count;
+}
+
+template <typename T>
+void PersistentHollowHeap<T>::insert(T el) {
+    shared_ptr<PersistentNode<T>> newNode = make_shared<PersistentNode<T>>(el);
+    min = min == nullptr ? newNode : link(min, newNode);
+    count++;
+}
+
+template <typename T>
+void PersistentHollowHeap<T>::merge(PersistentHollowHeap<T> &hh) {
+    if (hh.min == nullptr) {
+        return;
+    }
+    // hh keeps its own reference, so link copies its root instead of changing it
+    shared_ptr<PersistentNode<T>> otherMin = hh.min;
+    min = min == nullptr ? otherMin : link(min, otherMin);
+    count += hh.count;
+}
+
+template <typename T>
+T PersistentHollowHeap<T>::extractMin() {
+    T minVal = getMin();
+
+    // children are moved out of nodes nobody else refers to, and only read from shared ones,
+    // so use_count() == 1 still tells whether a root may be changed in place
+    shared_ptr<PersistentNode<T>> nextRoot = min.use_count() == 1 ? move(min->child) : min->child;
+    min = nullptr;
+
+    int maxRank = 0;
+    vector<shared_ptr<PersistentNode<T>>> fullRoots;
+    while (nextRoot != nullptr) {
+        shared_ptr<PersistentNode<T>> root = move(nextRoot);
+        nextRoot = root.use_count() == 1 ? move(root->next) : root->next;
+        maxRank = doRankedLinks(root, maxRank, fullRoots);
+    }
+
+    for (int i = 0; i <= maxRank && i < (int) fullRoots.size(); i++) {
+        if (fullRoots[i] != nullptr) {
+            min = min == nullptr ? move(fullRoots[i]) : link(min, fullRoots[i]);
+            fullRoots[i] = nullptr;
+        }
+    }
+    // a root read from a shared child list may still point to its old siblings
+    if (min != nullptr && min->next != nullptr) {
+        makeWritable(min);
+        min->next = nullptr;
+    }
+    count--;
+    return minVal;
+}
+
+// the copy shares every node with this heap until one of them links it
+template <typename T>
+PersistentHollowHeap<T> PersistentHollowHeap<T>::clone() {
+    return *this;
+}
+
+template <typename T>
+long long PersistentHollowHeap<T>::getCopiedNodes() {
+    return copiedNodes;
+}
+
+template <typename T>
+void PersistentHollowHeap<T>::makeWritable(shared_ptr<PersistentNode<T>> &node) {
+    if (node.use_count() != 1) {
+        node = make_shared<PersistentNode<T>>(*node);
+        copiedNodes++;
+    }
+}
+
+template <typename T>
+shared_ptr<PersistentNode<T>> PersistentHollowHeap<T>::link(
+        shared_ptr<PersistentNode<T>> &n1,
+        shared_ptr<PersistentNode<T>> &n2
+) {
+    shared_ptr<PersistentNode<T>> &parent = n1->key >= n2->key ? n2 : n1;
+    shared_ptr<PersistentNode<T>> &futureChild = n1->key >= n2->key ? n1 : n2;
+    makeWritable(parent);
+    makeWritable(futureChild);
+
+    futureChild->next = move(parent->child);
+    parent->child = move(futureChild);
+    return move(parent);
+}
+
+// returns maxRank found so far in fullRoots array
+template <typename T>
+int PersistentHollowHeap<T>::doRankedLinks(
+        shared_ptr<PersistentNode<T>> &node,
+        int maxRank,
+        vector<shared_ptr<PersistentNode<T>>> &fullRoots
+) {
+    while (fullRoots.size() > (size_t) node->rank && fullRoots[node->rank] != nullptr) {
+        int linkedRank = node->rank;
+        node = link(node, fullRoots[linkedRank]);
+        fullRoots[linkedRank] = nullptr;
+        node->rank += 1;
+    }
+    if (fullRoots.size() <= (size_t) node->rank) {
+        fullRoots.resize(node->rank + 1);
+    }
+    int rank = node->rank;
+    // moved, so that the rank array holds the only reference
+    fullRoots[rank] = move(node);
+    maxRank = max(maxRank, rank);
+
+    return maxRank;
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cstdio>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+// head of a sorted run on disk, ordered by key
+template <typename T>
+struct RunHead {
+    T key;
+    int run = -1;
+
+    bool operator<(const RunHead<T> &other) const { return key < other.key; }
+    bool operator<=(const RunHead<T> &other) const { return key <= other.key; }
+    bool operator>=(const RunHead<T> &other) const { return key >= other.key; }
+};
+
+// Appends fixed-size records to a file, block by block.
+// An exclusive writer fails if the file already exists instead of truncating it
+template <typename T>
+class RunWriter {
+    static_assert(is_trivially_copyable<T>::value, "Run files store raw bytes of T");
+public:
+    explicit RunWriter(const string &path, size_t blockSize = 1 << 20, bool exclusive = false);
+    ~RunWriter();
+    RunWriter(const RunWriter &) = delete;
+    RunWriter &operator=(const RunWriter &) = delete;
+
+    void write(const T &el);
+    void close();
+    long long getBytesWritten();
+private:
+    FILE *file;
+    vector<T> buffer;
+    size_t capacity;
+    long long bytesWritten = 0;
+
+    void flush();
+};
+
+// Reads fixed-size records from a file. While one block is consumed,
+// the next one is read on a background thread
+template <typename T>
+class RunReader {
+    static_assert(is_trivially_copyable<T>::value, "Run files store raw bytes of T");
+public:
+    explicit RunReader(const string &path, size_t blockSize = 1 << 20);
+    ~RunReader();
+    RunReader(const RunReader &) = delete;
+    RunReader &operator=(const RunReader &) = delete;
+
+    bool isExhausted();
+    T peek();
+    T next();
+    long long getBytesRead();
+private:
+    FILE *file;
+    vector<T> current;
+    vector<T> prefetched;
+    size_t currentSize = 0;
+    size_t pos = 0;
+    future<size_t> pending;
+    long long bytesRead = 0;
+
+    void prefetch();
+    void swapBlocks();
+};
+
+template <typename T>
+RunWriter<T>::RunWriter(const string &path, size_t blockSize, bool exclusive) {
+    file = fopen(path.c_str(), exclusive ? "wbx" : "wb");
+    if (file == nullptr) {
+        throw runtime_error("Not able to open " + path + " for writing"
+                + (exclusive ? ", it may already exist" : ""));
+    }
+    capacity = max<size_t>(1, blockSize / sizeof(T));
+    buffer.reserve(capacity);
+}
+
+template <typename T>
+RunWriter<T>::~RunWriter() {
+    if (file != nullptr) {
+        fclose(file);
+    }
+}
+
+template <typename T>
+void RunWriter<T>::write(const T &el) {
+    buffer.push_back(el);
+    if (buffer.size() == capacity) {
+        flush();
+    }
+}
+
+template <typename T>
+void RunWriter<T>::close() {
+    flush();
+    if (fclose(file) != 0) {
+        file = nullptr;
+        throw runtime_error("Not able to close a run file");
+    }
+    file = nullptr;
+}
+
+template <typename T>
+long long RunWriter<T>::getBytesWritten() {
+    return bytesWritten;
+}
+
+template <typename T>
+void RunWriter<T>::flush() {
+    if (buffer.empty()) {
+        return;
+    }
+    if (fwrite(buffer.data(), sizeof(T), buffer.size(), file) != buffer.size()) {
+        throw runtime_error("Not able to write a run file");
+    }
+    bytesWritten += buffer.size() * sizeof(T);
+    buffer.clear();
+}
+
+template <typename T>
+RunReader<T>::RunReader(const string &path, size_t blockSize) {
+    file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        throw runtime_error("Not able to open " + path + " for reading");
+    }
+    size_t capacity = max<size_t>(1, blockSize / sizeof(T));
+    current.resize(capacity);
+    prefetched.resize(capacity);
+    // every block is read with a single fread, stdio buffering would only add a copy
+    setvbuf(file, nullptr, _IONBF, 0);
+
+    prefetch();
+    swapBlocks();
+}
+
+template <typename T>
+RunReader<T>::~RunReader() {
+    if (pending.valid()) {
+        pending.wait();
+    }
+    fclose(file);
+}
+
+template <typename T>
+bool RunReader<T>::isExhausted() {
+    return pos == currentSize;
+}
+
+template <typename T>
+T RunReader<T>::peek() {
+    if (isExhausted()) {
+        throw logic_error("The run is exhausted. Not able to read the next value");
+    }
+    return current[pos];
+}
+
+template <typename T>
+T RunReader<T>::next() {
+    T el = peek();
+    pos++;
+    if (pos == currentSize && currentSize == current.size()) {
+        swapBlocks();
+    }
+    return el;
+}
+
+template <typename T>
+long long RunReader<T>::getBytesRead() {
+    return bytesRead;
+}
+
+template <typename T>
+void RunReader<T>::prefetch() {
+    pending = async(launch::async, [this]() {
+        return fread(prefetched.data(), sizeof(T), prefetched.size(), file);
+    });
+}
+
+// makes the prefetched block current and starts reading the one after it
+template <typename T>
+void RunReader<T>::swapBlocks() {
+    currentSize = pending.get();
+    if (currentSize == 0 && ferror(file)) {
+        throw runtime_error("Not able to read a run file");
+    }
+    swap(current, prefetched);
+    pos = 0;
+    bytesRead += currentSize * sizeof(T);
+    if (currentSize == current.size()) {
+        prefetch();
+    }
+}
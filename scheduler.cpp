@@ -0,0 +1,199 @@
+#pragma once
+
+// Single-threaded scheduler of C++20 coroutines, needs -std=c++20
+
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <tuple>
+#include "hollow_heap.cpp"
+
+using namespace std;
+
+using SchedulerClock = chrono::steady_clock;
+
+struct TaskState;
+
+// wake-up order of a waiting task: earlier deadline first,
+// then smaller priority value, then the order of scheduling
+struct TaskKey {
+    SchedulerClock::time_point deadline;
+    int priority = 0;
+    long long sequence = 0;
+    TaskState *state = nullptr;
+
+    bool operator<(const TaskKey &other) const {
+        return tie(deadline, priority, sequence) < tie(other.deadline, other.priority, other.sequence);
+    }
+    bool operator==(const TaskKey &other) const {
+        return tie(deadline, priority, sequence) == tie(other.deadline, other.priority, other.sequence);
+    }
+    bool operator<=(const TaskKey &other) const { return !(other < *this); }
+    bool operator>=(const TaskKey &other) const { return !(*this < other); }
+};
+
+// shared by a task and the ids handed out for it, outlives the coroutine frame
+struct TaskState {
+    // null once the task has finished or has been cancelled
+    coroutine_handle<> handle;
+    // set while the task waits in the scheduler
+    shared_ptr<Item<TaskKey>> item;
+    int priority = 0;
+};
+
+using TaskId = shared_ptr<TaskState>;
+
+// Fire-and-forget coroutine. It starts suspended and runs once spawned
+// on a Scheduler; its frame is destroyed when it finishes or is cancelled
+struct Task {
+    struct promise_type {
+        shared_ptr<TaskState> state;
+
+        ~promise_type() {
+            if (state != nullptr) {
+                state->handle = nullptr;
+            }
+        }
+        Task get_return_object() {
+            return Task{coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        suspend_always initial_suspend() noexcept { return {}; }
+        suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { terminate(); }
+    };
+
+    coroutine_handle<promise_type> handle;
+};
+
+struct SchedulerStats {
+    long long wakeups = 0;
+    // how late tasks were resumed after their deadline
+    chrono::nanoseconds totalLateness{0};
+    chrono::nanoseconds maxLateness{0};
+};
+
+// Waiting tasks are kept in a HollowHeap keyed by (deadline, priority).
+// Raising the priority of a waiting task is a decreaseKey, cancelling it a deleteItem
+class Scheduler {
+public:
+    Scheduler() = default;
+    ~Scheduler();
+    Scheduler(const Scheduler &) = delete;
+    Scheduler &operator=(const Scheduler &) = delete;
+
+    TaskId spawn(Task task, int priority = 0);
+    void run();
+    bool cancel(TaskId &id);
+    void reprioritize(TaskId &id, int priority);
+    int size();
+    SchedulerStats getStats();
+
+    struct SleepAwaiter {
+        Scheduler &scheduler;
+        SchedulerClock::time_point deadline;
+
+        bool await_ready() { return false; }
+        void await_suspend(coroutine_handle<>) { scheduler.schedule(*scheduler.current, deadline); }
+        void await_resume() {}
+    };
+
+    // suspends the running task until deadline
+    SleepAwaiter sleepUntil(SchedulerClock::time_point deadline);
+    // changes the priority of the running task and yields to the tasks that are already due
+    SleepAwaiter reprioritize(int priority);
+private:
+    HollowHeap<TaskKey> queue;
+    long long sequence = 0;
+    // the running task, kept alive by its coroutine frame
+    TaskState *current = nullptr;
+    SchedulerStats stats;
+
+    void schedule(TaskState &state, SchedulerClock::time_point deadline);
+};
+
+inline Scheduler::~Scheduler() {
+    while (!queue.isEmpty()) {
+        TaskState *state = queue.extractMin().state;
+        state->item = nullptr;
+        state->handle.destroy();
+    }
+}
+
+inline TaskId Scheduler::spawn(Task task, int priority) {
+    TaskId state = make_shared<TaskState>();
+    state->handle = task.handle;
+    state->priority = priority;
+    task.handle.promise().state = state;
+    schedule(*state, SchedulerClock::now());
+    return state;
+}
+
+// resumes tasks in key order until none is waiting, sleeping until the next deadline
+inline void Scheduler::run() {
+    while (!queue.isEmpty()) {
+        TaskKey next = queue.getMin();
+        SchedulerClock::time_point now = SchedulerClock::now();
+        if (next.deadline > now) {
+            this_thread::sleep_until(next.deadline);
+            now = SchedulerClock::now();
+        }
+        queue.extractMin();
+
+        chrono::nanoseconds lateness = now - next.deadline;
+        stats.wakeups++;
+        stats.totalLateness += lateness;
+        stats.maxLateness = max(stats.maxLateness, lateness);
+
+        TaskState *state = next.state;
+        state->item = nullptr;
+        current = state;
+        state->handle.resume();
+        current = nullptr;
+    }
+}
+
+// removes a waiting task and destroys its frame.
+// returns false if the task is running or has already finished
+inline bool Scheduler::cancel(TaskId &id) {
+    if (id->item == nullptr) {
+        return false;
+    }
+    queue.deleteItem(id->item);
+    id->item = nullptr;
+    id->handle.destroy();
+    return true;
+}
+
+// a smaller value is more urgent. A waiting task is moved in the queue right away
+inline void Scheduler::reprioritize(TaskId &id, int priority) {
+    id->priority = priority;
+    if (id->item != nullptr) {
+        TaskKey key = id->item->getValue();
+        key.priority = priority;
+        queue.updateKey(id->item, key);
+    }
+}
+
+inline int Scheduler::size() {
+    return queue.size();
+}
+
+inline SchedulerStats Scheduler::getStats() {
+    return stats;
+}
+
+inline Scheduler::SleepAwaiter Scheduler::sleepUntil(SchedulerClock::time_point deadline) {
+    return SleepAwaiter{*this, deadline};
+}
+
+inline Scheduler::SleepAwaiter Scheduler::reprioritize(int priority) {
+    current->priority = priority;
+    return SleepAwaiter{*this, SchedulerClock::now()};
+}
+
+inline void Scheduler::schedule(TaskState &state, SchedulerClock::time_point deadline) {
+    state.item = queue.insert(TaskKey{deadline, state.priority, sequence++, &state});
+}
@@ -1,5 +1,15 @@
 #include <cassert>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <sys/resource.h>
 #include "hollow_heap.cpp"
+#include "external_hollow_heap.cpp"
+#include "kway_merge.cpp"
+#include "persistent_hollow_heap.cpp"
+#if __cplusplus >= 202002L
+#include "scheduler.cpp"
+#endif
 
 // insert
 void insertToEmptyHeap() {
@@ -145,6 +155,99 @@ void extractMinAndDo4RecursiveMerges() {
     assert(f1.extractMin() == 1);
 }
 
+// ranks can outgrow log2(size) once decreases leave hollow nodes behind
+void extractMinAfterManyDecreases() {
+    HollowHeap<int> f1;
+    vector<shared_ptr<Item<int>>> items;
+    for (int i = 0; i < 64; i++) {
+        items.push_back(f1.insert(100 + i));
+    }
+    f1.extractMin();
+
+    for (int round = 0; round < 8; round++) {
+        for (int i = 1 + round; i < 64; i += 3) {
+            if (items[i]->isInHeap()) {
+                f1.decreaseKey(items[i], items[i]->getValue() - 1);
+            }
+        }
+        f1.insert(1000 + round);
+        f1.extractMin();
+        f1.checkInvariants();
+    }
+
+    int previous = f1.extractMin();
+    while (!f1.isEmpty()) {
+        int current = f1.extractMin();
+        assert(previous <= current);
+        previous = current;
+    }
+}
+
+void singleThreadKeepsSerialConsolidation() {
+    HollowHeap<int> f1;
+    f1.setParallelConsolidationThreshold(1);
+    f1.setParallelConsolidationThreads(1);
+    for (int i = 0; i < 100; i++) {
+        f1.insert((i * 37) % 100);
+    }
+
+    for (int i = 0; i < 100; i++) {
+        assert(f1.extractMin() == i);
+    }
+    assert(f1.getParallelConsolidations() == 0);
+}
+
+void extractMinAfterBulkDelete() {
+    HollowHeap<int> f1;
+    f1.setParallelConsolidationThreshold(64);
+    f1.setParallelConsolidationThreads(4);
+    vector<shared_ptr<Item<int>>> items;
+    for (int i = 0; i < 4096; i++) {
+        items.push_back(f1.insert((i * 37) % 4096));
+    }
+    assert(f1.extractMin() == 0);
+    long long parallelConsolidations = f1.getParallelConsolidations();
+
+    // deletions do no links, but the children of the deleted nodes become roots
+    for (int i = 0; i < 4096; i++) {
+        if (i % 8 != 0 && items[i]->isInHeap()) {
+            f1.deleteItem(items[i]);
+        }
+    }
+    assert(f1.size() == 511);
+    assert(f1.extractMin() == 8);
+    assert(f1.getParallelConsolidations() > parallelConsolidations);
+    f1.checkInvariants();
+    for (int key = 16; key < 4096; key += 8) {
+        assert(f1.extractMin() == key);
+    }
+}
+
+void extractMinWithParallelConsolidation() {
+    HollowHeap<int> f1;
+    f1.setParallelConsolidationThreshold(1);
+    f1.setParallelConsolidationThreads(4);
+    vector<shared_ptr<Item<int>>> items;
+    for (int i = 0; i < 500; i++) {
+        items.push_back(f1.insert((i * 37) % 500));
+    }
+    f1.extractMin();
+    for (int i = 0; i < 500; i += 7) {
+        if (items[i]->isInHeap()) {
+            f1.decreaseKey(items[i], items[i]->getValue() - 250);
+        }
+    }
+    f1.checkInvariants();
+
+    int previous = f1.extractMin();
+    f1.checkInvariants();
+    while (!f1.isEmpty()) {
+        int current = f1.extractMin();
+        assert(previous <= current);
+        previous = current;
+    }
+}
+
 // decreaseKey
 void decreaseKeyWhenAllNodesAreRoots() {
     HollowHeap<int> f1;
@@ -210,6 +313,51 @@ void decreaseKeyOfLeaf() {
     assert(f1.extractMin() == 0);
 }
 
+void decreaseKeyInPlaceAboveParent() {
+    HollowHeap<int> f1;
+    f1.insert(1);
+    shared_ptr<Item<int>> n = f1.insert(10);
+
+    f1.decreaseKey(n, 5);
+
+    assert(f1.getInPlaceDecreases() == 1);
+    f1.checkInvariants();
+    assert(f1.extractMin() == 1);
+    assert(f1.extractMin() == 5);
+}
+
+void decreaseKeyBelowParent() {
+    HollowHeap<int> f1;
+    f1.insert(1);
+    shared_ptr<Item<int>> n = f1.insert(10);
+
+    f1.decreaseKey(n, 0);
+
+    assert(f1.getInPlaceDecreases() == 0);
+    f1.checkInvariants();
+    assert(f1.extractMin() == 0);
+    assert(f1.extractMin() == 1);
+}
+
+void decreaseKeysAfterConsolidation() {
+    HollowHeap<int> f1;
+    vector<shared_ptr<Item<int>>> items(100);
+    for (int i = 0; i < 100; i++) {
+        int key = (i * 37) % 100;
+        items[key] = f1.insert(2 * key);
+    }
+    f1.extractMin();
+    for (int i = 1; i < 100; i++) {
+        f1.decreaseKey(items[i], 2 * i - 1);
+        f1.checkInvariants();
+    }
+
+    assert(f1.getInPlaceDecreases() > 0);
+    for (int i = 1; i < 100; i++) {
+        assert(f1.extractMin() == 2 * i - 1);
+    }
+}
+
 void decreaseKeyOfNodeWithMarkedParent() {
     HollowHeap<int> f1;
 
@@ -317,6 +465,717 @@ void deleteLeaf() {
     assert(f1.extractMin() == 2);
 }
 
+// updateKey
+void increaseKeyOfLeaf() {
+    HollowHeap<int> f1;
+    shared_ptr<Item<int>> nodeToIncrease;
+    for (int i = 0; i < 17; i++) {
+        shared_ptr<Item<int>> n = f1.insert(i);
+
+        if (i == 12) {
+            nodeToIncrease = n;
+        }
+    }
+    f1.extractMin();
+
+    f1.updateKey(nodeToIncrease, 100);
+
+    assert(f1.size() == 16);
+    assert(nodeToIncrease->getValue() == 100);
+    f1.checkInvariants();
+    for (int i = 1; i < 17; i++) {
+        if (i != 12) {
+            assert(f1.extractMin() == i);
+        }
+    }
+    assert(f1.extractMin() == 100);
+}
+
+void increaseKeyOfNodeWithChildren() {
+    HollowHeap<int> f1;
+    shared_ptr<Item<int>> nodeToIncrease;
+    for (int i = 0; i < 17; i++) {
+        shared_ptr<Item<int>> n = f1.insert(i);
+
+        if (i == 1) {
+            nodeToIncrease = n;
+        }
+    }
+    f1.extractMin();
+    f1.insert(0);
+
+    f1.updateKey(nodeToIncrease, 20);
+
+    assert(f1.size() == 17);
+    assert(nodeToIncrease->isInHeap());
+    f1.checkInvariants();
+    assert(f1.extractMin() == 0);
+    assert(f1.extractMin() == 2);
+
+    f1.updateKey(nodeToIncrease, 3);
+    assert(f1.extractMin() == 3);
+    assert(f1.extractMin() == 3);
+    assert(!nodeToIncrease->isInHeap());
+}
+
+void increaseKeyOfMin() {
+    HollowHeap<int> f1;
+    shared_ptr<Item<int>> n = f1.insert(1);
+    f1.insert(2);
+    f1.insert(3);
+
+    f1.updateKey(n, 4);
+
+    assert(n->isInHeap());
+    assert(f1.extractMin() == 2);
+    assert(f1.extractMin() == 3);
+    assert(f1.extractMin() == 4);
+}
+
+void updateKeyOfExtractedItem() {
+    HollowHeap<int> f1;
+    shared_ptr<Item<int>> n = f1.insert(1);
+    f1.extractMin();
+
+    bool thrown = false;
+    try {
+        f1.updateKey(n, 2);
+    } catch (const logic_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+// replaceMin
+void replaceMinWithLargerKey() {
+    HollowHeap<int> f1;
+    shared_ptr<Item<int>> n = f1.insert(1);
+    f1.insert(2);
+    f1.insert(3);
+    f1.insert(4);
+
+    assert(f1.replaceMin(5) == 1);
+    assert(n->isInHeap());
+    assert(n->getValue() == 5);
+    assert(f1.size() == 4);
+    f1.checkInvariants();
+    assert(f1.extractMin() == 2);
+    assert(f1.extractMin() == 3);
+    assert(f1.extractMin() == 4);
+    assert(f1.extractMin() == 5);
+}
+
+void replaceMinWithSmallerKey() {
+    HollowHeap<int> f1;
+    shared_ptr<Item<int>> n = f1.insert(3);
+    f1.insert(4);
+
+    assert(f1.replaceMin(1) == 3);
+    assert(n->getValue() == 1);
+    assert(f1.getMin() == 1);
+    assert(f1.size() == 2);
+}
+
+void replaceMinOfSingleItem() {
+    HollowHeap<int> f1;
+    f1.insert(3);
+
+    assert(f1.replaceMin(7) == 3);
+    assert(f1.size() == 1);
+    assert(f1.extractMin() == 7);
+}
+
+void replaceMinOfEmptyHeap() {
+    HollowHeap<int> f1;
+    bool thrown = false;
+    try {
+        f1.replaceMin(1);
+    } catch (const logic_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+// bounded capacity
+void keepTopKOfStream() {
+    HollowHeap<int> f1;
+    f1.setCapacity(5);
+    int rejected = 0;
+    for (int i = 0; i < 100; i++) {
+        if (f1.insert((i * 37) % 100) == nullptr) {
+            rejected++;
+        }
+    }
+
+    assert(f1.size() == 5);
+    assert(rejected > 0);
+    f1.checkInvariants();
+    for (int i = 95; i < 100; i++) {
+        assert(f1.extractMin() == i);
+    }
+}
+
+void rejectKeyNotLargerThanMin() {
+    HollowHeap<int> f1;
+    f1.setCapacity(2);
+    f1.insert(3);
+    f1.insert(5);
+
+    assert(f1.insert(3) == nullptr);
+    assert(f1.insert(1) == nullptr);
+    assert(f1.size() == 2);
+    assert(f1.getMin() == 3);
+}
+
+void evictedItemHeldByCallerIsNotReused() {
+    HollowHeap<int> f1;
+    f1.setCapacity(2);
+    shared_ptr<Item<int>> evicted = f1.insert(1);
+    f1.insert(5);
+
+    shared_ptr<Item<int>> inserted = f1.insert(7);
+
+    assert(inserted != evicted);
+    assert(!evicted->isInHeap());
+    assert(evicted->getValue() == 1);
+    assert(inserted->isInHeap());
+    assert(f1.extractMin() == 5);
+    assert(f1.extractMin() == 7);
+}
+
+void shrinkCapacity() {
+    HollowHeap<int> f1;
+    for (int i = 0; i < 10; i++) {
+        f1.insert(i);
+    }
+    f1.setCapacity(3);
+
+    assert(f1.size() == 3);
+    assert(f1.extractMin() == 7);
+}
+
+void mergeIntoFullHeap() {
+    HollowHeap<int> f1;
+    f1.setCapacity(2);
+    f1.insert(10);
+    f1.insert(11);
+    HollowHeap<int> f2;
+    for (int i = 0; i < 5; i++) {
+        f2.insert(5 + 3 * i);
+    }
+
+    f1.merge(f2);
+
+    assert(f1.size() == 2);
+    f1.checkInvariants();
+    for (int i = 0; i < 5; i++) {
+        f1.insert(20 + i);
+    }
+    assert(f1.size() == 2);
+    assert(f1.extractMin() == 23);
+    assert(f1.extractMin() == 24);
+}
+
+// allocators
+class CountingResource: public pmr::memory_resource {
+public:
+    int allocations = 0;
+    // allocations and deallocations by threads other than the one that created the resource
+    atomic<int> foreignCalls{0};
+private:
+    thread::id owner = this_thread::get_id();
+
+    void *do_allocate(size_t bytes, size_t alignment) override {
+        allocations++;
+        if (this_thread::get_id() != owner) {
+            foreignCalls++;
+        }
+        return pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+        if (this_thread::get_id() != owner) {
+            foreignCalls++;
+        }
+        pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+};
+
+void allocateFromMemoryResource() {
+    CountingResource resource;
+    PmrHollowHeap<int> f1(&resource);
+    for (int i = 0; i < 17; i++) {
+        f1.insert(i);
+    }
+    // one node and one item per insert
+    assert(resource.allocations == 34);
+
+    f1.extractMin();
+    assert(resource.allocations > 34);
+    assert(f1.extractMin() == 1);
+}
+
+void parallelConsolidationAllocatesFromResource() {
+    CountingResource resource;
+    CountingResource defaultResource;
+    pmr::memory_resource *previousDefault = pmr::set_default_resource(&defaultResource);
+    PmrHollowHeap<int> f1(&resource);
+    f1.setParallelConsolidationThreshold(1);
+    f1.setParallelConsolidationThreads(4);
+    for (int i = 0; i < 1000; i++) {
+        f1.insert((i * 37) % 1000);
+    }
+
+    for (int i = 0; i < 1000; i++) {
+        assert(f1.extractMin() == i);
+    }
+    pmr::set_default_resource(previousDefault);
+    assert(f1.getParallelConsolidations() > 0);
+    assert(defaultResource.allocations == 0);
+    assert(resource.foreignCalls == 0);
+}
+
+void parallelConsolidationAfterBulkDeleteStaysOnCallingThread() {
+    CountingResource resource;
+    PmrHollowHeap<int> f1(&resource);
+    f1.setParallelConsolidationThreshold(64);
+    f1.setParallelConsolidationThreads(4);
+    vector<shared_ptr<Item<int>>> items;
+    for (int i = 0; i < 4096; i++) {
+        items.push_back(f1.insert((i * 37) % 4096));
+    }
+    f1.extractMin();
+    for (int i = 0; i < 4096; i++) {
+        if (i % 8 != 0 && items[i]->isInHeap()) {
+            f1.deleteItem(items[i]);
+        }
+    }
+    // the deleted items are gone, only the heap can free the hollow nodes now
+    items.clear();
+
+    assert(f1.extractMin() == 8);
+    assert(f1.getParallelConsolidations() > 0);
+    assert(resource.foreignCalls == 0);
+}
+
+void allocateFromMonotonicBuffer() {
+    char buffer[1 << 14];
+    pmr::monotonic_buffer_resource resource(buffer, sizeof(buffer), pmr::null_memory_resource());
+    PmrHollowHeap<int> f1(&resource);
+    shared_ptr<Item<int>> n;
+    for (int i = 0; i < 20; i++) {
+        shared_ptr<Item<int>> item = f1.insert(20 - i);
+        if (i == 5) {
+            n = item;
+        }
+    }
+    f1.extractMin();
+    f1.decreaseKey(n, 0);
+
+    assert(f1.extractMin() == 0);
+    assert(f1.extractMin() == 2);
+}
+
+void decreaseKeyReusesHollowNodes() {
+    CountingResource resource;
+    PmrHollowHeap<int> f1(&resource);
+    vector<shared_ptr<Item<int>>> items;
+    for (int i = 0; i < 32; i++) {
+        items.push_back(f1.insert(100 + i));
+    }
+    f1.extractMin();
+    for (int i = 1; i < 32; i += 2) {
+        f1.decreaseKey(items[i], i);
+    }
+    f1.extractMin();
+
+    int allocations = resource.allocations;
+    long long avoided = f1.getAvoidedAllocations();
+    for (int i = 2; i < 32; i += 2) {
+        f1.decreaseKey(items[i], i);
+    }
+
+    // the old minimum freed by the last extractMin is reused at least
+    avoided = f1.getAvoidedAllocations() - avoided;
+    assert(avoided > 0);
+    assert(resource.allocations - allocations == 15 - avoided);
+    f1.checkInvariants();
+    for (int i = 2; i < 32; i++) {
+        assert(f1.extractMin() == i);
+    }
+}
+
+void keepTopKOfStreamWithoutAllocations() {
+    CountingResource resource;
+    PmrHollowHeap<int> f1(&resource);
+    f1.setCapacity(100);
+    for (int i = 0; i < 200; i++) {
+        f1.insert(i);
+    }
+
+    // every insert evicts the minimum and reuses its item, node and the rank array
+    int allocations = resource.allocations;
+    for (int i = 200; i < 10200; i++) {
+        f1.insert(i);
+    }
+    assert(resource.allocations == allocations);
+    f1.checkInvariants();
+    for (int i = 10100; i < 10200; i++) {
+        assert(f1.extractMin() == i);
+    }
+}
+
+// external memory
+
+// private directory for the run files of one test, removed with everything in it
+struct TestDirectory {
+    string path;
+
+    TestDirectory() {
+        string pattern = (filesystem::temp_directory_path() / "hollow-heap-test-XXXXXX").string();
+        if (mkdtemp(&pattern[0]) == nullptr) {
+            throw runtime_error("Not able to create a directory from " + pattern);
+        }
+        path = pattern;
+    }
+    ~TestDirectory() {
+        filesystem::remove_all(path);
+    }
+};
+
+void spillToDiskAndExtractInOrder() {
+    TestDirectory testDirectory;
+    string directory = testDirectory.path;
+    ExternalHollowHeap<int> f1(directory, 8, 4 * sizeof(int));
+    for (int i = 0; i < 100; i++) {
+        f1.insert((i * 37) % 100);
+    }
+
+    assert(f1.size() == 100);
+    assert(f1.getRunCount() > 1);
+    assert(f1.getIoCounters().bytesWritten > 0);
+    for (int i = 0; i < 100; i++) {
+        assert(f1.getMin() == i);
+        assert(f1.extractMin() == i);
+    }
+    assert(f1.isEmpty());
+    assert(f1.getRunCount() == 0);
+    assert(f1.getIoCounters().bytesRead == f1.getIoCounters().bytesWritten);
+}
+
+void interleaveInsertsWithSpilledRuns() {
+    TestDirectory testDirectory;
+    string directory = testDirectory.path;
+    ExternalHollowHeap<int> f1(directory, 4);
+    for (int i = 10; i < 30; i++) {
+        f1.insert(i);
+    }
+    assert(f1.extractMin() == 10);
+
+    f1.insert(5);
+    f1.insert(11);
+    assert(f1.extractMin() == 5);
+    assert(f1.extractMin() == 11);
+    assert(f1.extractMin() == 11);
+    assert(f1.size() == 18);
+}
+
+void mergeRunsPastFanIn() {
+    TestDirectory testDirectory;
+    string directory = testDirectory.path;
+    ExternalHollowHeap<int> f1(directory, 4, 4 * sizeof(int), 3);
+    for (int i = 0; i < 2000; i++) {
+        f1.insert((i * 7919) % 2000);
+        assert(f1.getRunCount() <= 3);
+    }
+
+    for (int i = 0; i < 2000; i++) {
+        assert(f1.extractMin() == i);
+    }
+    assert(f1.isEmpty());
+    assert(f1.getRunCount() == 0);
+    // merged runs are written and read again, but every byte written is read once
+    assert(f1.getIoCounters().bytesWritten > 2000 * (long long) sizeof(int));
+    assert(f1.getIoCounters().bytesRead == f1.getIoCounters().bytesWritten);
+}
+
+// k-way merge
+void writeRun(const string &path, const vector<int> &values) {
+    RunWriter<int> writer(path, 4 * sizeof(int));
+    for (int value : values) {
+        writer.write(value);
+    }
+    writer.close();
+}
+
+void mergeSortedRuns() {
+    TestDirectory testDirectory;
+    string directory = testDirectory.path;
+    vector<string> inputs;
+    for (int run = 0; run < 5; run++) {
+        vector<int> values;
+        for (int i = run; i < 50; i += 5) {
+            values.push_back(i);
+        }
+        inputs.push_back(directory + "/kway-merge-test-" + to_string(run) + ".bin");
+        writeRun(inputs.back(), values);
+    }
+    inputs.push_back(directory + "/kway-merge-test-empty.bin");
+    writeRun(inputs.back(), {});
+
+    string output = directory + "/kway-merge-test-output.bin";
+    MergeStats stats = kwayMerge<int>(inputs, output, 4 * sizeof(int));
+    assert(stats.bytesRead == 50 * sizeof(int));
+    assert(stats.bytesWritten == 50 * sizeof(int));
+
+    RunReader<int> reader(output);
+    for (int i = 0; i < 50; i++) {
+        assert(reader.next() == i);
+    }
+    assert(reader.isExhausted());
+}
+
+void mergeMoreRunsThanOpenFiles() {
+    TestDirectory testDirectory;
+    string directory = testDirectory.path;
+    vector<string> inputs;
+    for (int run = 0; run < 1100; run++) {
+        inputs.push_back(directory + "/kway-merge-test-" + to_string(run) + ".bin");
+        writeRun(inputs.back(), {run, run + 1100, run + 2200});
+    }
+
+    // opening all inputs at once would run out of file descriptors
+    rlimit previousLimit;
+    getrlimit(RLIMIT_NOFILE, &previousLimit);
+    rlimit limit = previousLimit;
+    limit.rlim_cur = 256;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    string output = directory + "/kway-merge-test-output.bin";
+    MergeStats stats = kwayMerge<int>(inputs, output, 4 * sizeof(int), 16);
+    setrlimit(RLIMIT_NOFILE, &previousLimit);
+
+    // intermediate runs are written and read again, but every byte written is read once
+    assert(stats.bytesWritten > 3300 * (long long) sizeof(int));
+    assert(stats.bytesRead == stats.bytesWritten);
+    RunReader<int> reader(output);
+    for (int i = 0; i < 3300; i++) {
+        assert(reader.next() == i);
+    }
+    assert(reader.isExhausted());
+    // only the inputs and the output are left
+    assert(distance(filesystem::directory_iterator(directory), filesystem::directory_iterator()) == 1101);
+}
+
+void exclusiveWriterKeepsExistingFile() {
+    TestDirectory testDirectory;
+    string path = testDirectory.path + "/run.bin";
+    writeRun(path, {1, 2, 3});
+
+    bool thrown = false;
+    try {
+        RunWriter<int> writer(path, 4 * sizeof(int), true);
+    } catch (runtime_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+    assert(filesystem::file_size(path) == 3 * sizeof(int));
+}
+
+// persistent heap
+void cloneIsIndependentOfOriginal() {
+    PersistentHollowHeap<int> f1;
+    for (int i = 0; i < 100; i++) {
+        f1.insert((i * 37) % 100);
+    }
+    PersistentHollowHeap<int> f2 = f1.clone();
+    for (int i = 0; i < 50; i++) {
+        assert(f2.extractMin() == i);
+    }
+    f1.insert(-1);
+    f2.insert(200);
+
+    assert(f1.size() == 101);
+    assert(f1.extractMin() == -1);
+    for (int i = 0; i < 100; i++) {
+        assert(f1.extractMin() == i);
+    }
+    assert(f2.size() == 51);
+    for (int i = 50; i < 100; i++) {
+        assert(f2.extractMin() == i);
+    }
+    assert(f2.extractMin() == 200);
+    assert(f2.isEmpty());
+}
+
+void unsharedHeapCopiesNoNodes() {
+    PersistentHollowHeap<int> f1;
+    for (int i = 0; i < 100; i++) {
+        f1.insert((i * 37) % 100);
+    }
+    for (int i = 0; i < 100; i++) {
+        assert(f1.extractMin() == i);
+    }
+    assert(f1.getCopiedNodes() == 0);
+}
+
+void forkManyTimes() {
+    PersistentHollowHeap<int> base;
+    for (int i = 0; i < 1000; i++) {
+        base.insert((i * 7919) % 1000);
+    }
+    base.extractMin();
+
+    vector<PersistentHollowHeap<int>> forks;
+    for (int fork = 0; fork < 100; fork++) {
+        forks.push_back(base.clone());
+        forks.back().insert(-fork);
+        assert(forks.back().extractMin() == -fork);
+        assert(forks.back().extractMin() == 1);
+    }
+    for (int fork = 0; fork < 100; fork++) {
+        assert(forks[fork].getMin() == 2);
+        assert(forks[fork].size() == 998);
+    }
+    assert(base.size() == 999);
+    for (int i = 1; i < 1000; i++) {
+        assert(base.extractMin() == i);
+    }
+}
+
+void mergeKeepsOtherHeap() {
+    PersistentHollowHeap<int> f1;
+    PersistentHollowHeap<int> f2;
+    for (int i = 0; i < 10; i++) {
+        f1.insert(2 * i);
+        f2.insert(2 * i + 1);
+    }
+    f1.merge(f2);
+    assert(f1.size() == 20);
+    for (int i = 0; i < 20; i++) {
+        assert(f1.extractMin() == i);
+    }
+    for (int i = 0; i < 10; i++) {
+        assert(f2.extractMin() == 2 * i + 1);
+    }
+}
+
+void mergeWithOwnClone() {
+    PersistentHollowHeap<int> f1;
+    for (int i = 0; i < 10; i++) {
+        f1.insert(i);
+    }
+    f1.extractMin();
+    PersistentHollowHeap<int> f2 = f1.clone();
+    f1.merge(f2);
+    assert(f1.size() == 18);
+    for (int i = 1; i < 10; i++) {
+        assert(f1.extractMin() == i);
+        assert(f1.extractMin() == i);
+    }
+    assert(f2.size() == 9);
+    assert(f2.getMin() == 1);
+}
+
+#if __cplusplus >= 202002L
+// scheduler
+Task recordAfterSleep(
+        Scheduler &scheduler,
+        vector<int> &order,
+        int id,
+        SchedulerClock::time_point deadline
+) {
+    co_await scheduler.sleepUntil(deadline);
+    order.push_back(id);
+}
+
+void wakeTasksByDeadline() {
+    Scheduler scheduler;
+    vector<int> order;
+    SchedulerClock::time_point now = SchedulerClock::now();
+    scheduler.spawn(recordAfterSleep(scheduler, order, 0, now + chrono::milliseconds(3)));
+    scheduler.spawn(recordAfterSleep(scheduler, order, 1, now + chrono::milliseconds(1)));
+    scheduler.spawn(recordAfterSleep(scheduler, order, 2, now + chrono::milliseconds(2)));
+
+    scheduler.run();
+
+    assert((order == vector<int>{1, 2, 0}));
+    assert(scheduler.getStats().wakeups == 6);
+    assert(scheduler.size() == 0);
+}
+
+// tasks first run when spawned, so they all wait for due only after that
+void wakeDueTasksByPriority() {
+    Scheduler scheduler;
+    vector<int> order;
+    SchedulerClock::time_point due = SchedulerClock::now() + chrono::milliseconds(20);
+    scheduler.spawn(recordAfterSleep(scheduler, order, 0, due), 2);
+    scheduler.spawn(recordAfterSleep(scheduler, order, 1, due), 0);
+    scheduler.spawn(recordAfterSleep(scheduler, order, 2, due), 1);
+
+    scheduler.run();
+
+    assert((order == vector<int>{1, 2, 0}));
+}
+
+Task reprioritizeOther(
+        Scheduler &scheduler,
+        TaskId &other,
+        int priority,
+        SchedulerClock::time_point when
+) {
+    co_await scheduler.sleepUntil(when);
+    scheduler.reprioritize(other, priority);
+}
+
+void raisePriorityOfWaitingTask() {
+    Scheduler scheduler;
+    vector<int> order;
+    SchedulerClock::time_point now = SchedulerClock::now();
+    SchedulerClock::time_point due = now + chrono::milliseconds(20);
+    scheduler.spawn(recordAfterSleep(scheduler, order, 0, due), 1);
+    scheduler.spawn(recordAfterSleep(scheduler, order, 1, due), 1);
+    TaskId last = scheduler.spawn(recordAfterSleep(scheduler, order, 2, due), 1);
+    scheduler.spawn(reprioritizeOther(scheduler, last, 0, now + chrono::milliseconds(10)));
+
+    scheduler.run();
+
+    assert((order == vector<int>{2, 0, 1}));
+}
+
+Task reprioritizeItself(Scheduler &scheduler, vector<int> &order, int id) {
+    co_await scheduler.reprioritize(5);
+    order.push_back(id);
+}
+
+void yieldAfterReprioritize() {
+    Scheduler scheduler;
+    vector<int> order;
+    scheduler.spawn(reprioritizeItself(scheduler, order, 0));
+    scheduler.spawn(recordAfterSleep(scheduler, order, 1, SchedulerClock::now()));
+
+    scheduler.run();
+
+    assert((order == vector<int>{1, 0}));
+}
+
+void cancelWaitingTask() {
+    Scheduler scheduler;
+    vector<int> order;
+    SchedulerClock::time_point due = SchedulerClock::now();
+    scheduler.spawn(recordAfterSleep(scheduler, order, 0, due));
+    TaskId cancelled = scheduler.spawn(recordAfterSleep(scheduler, order, 1, due));
+
+    assert(scheduler.cancel(cancelled));
+    assert(!scheduler.cancel(cancelled));
+    scheduler.run();
+
+    assert((order == vector<int>{0}));
+    assert(cancelled->handle == nullptr);
+}
+#endif
+
 // general tests
 void basicTest1() {
     HollowHeap<int> fib;
@@ -534,11 +1393,18 @@ void runTests() {
     extractNodeWithChildren();
     extractMinAndMergeAllToOneRoot();
     extractMinAndDo4RecursiveMerges();
+    extractMinAfterManyDecreases();
+    extractMinWithParallelConsolidation();
+    extractMinAfterBulkDelete();
+    singleThreadKeepsSerialConsolidation();
 
     decreaseKeyWhenAllNodesAreRoots();
 
     decreaseKeyOfRoot();
     decreaseKeyOfLeaf();
+    decreaseKeyInPlaceAboveParent();
+    decreaseKeyBelowParent();
+    decreaseKeysAfterConsolidation();
     decreaseKeyOfMinNode();
     decreaseKeyOfNodeWithMarkedParent();
     decreaseKeyOfMinNodeWithAllAncestorsMarked();
@@ -547,4 +1413,48 @@ void runTests() {
     deleteLeaf();
     deleteRoot();
     deleteItemInTheMiddle();
+
+    increaseKeyOfLeaf();
+    increaseKeyOfNodeWithChildren();
+    increaseKeyOfMin();
+    updateKeyOfExtractedItem();
+
+    replaceMinWithLargerKey();
+    replaceMinWithSmallerKey();
+    replaceMinOfSingleItem();
+    replaceMinOfEmptyHeap();
+
+    keepTopKOfStream();
+    rejectKeyNotLargerThanMin();
+    evictedItemHeldByCallerIsNotReused();
+    shrinkCapacity();
+    mergeIntoFullHeap();
+
+    allocateFromMemoryResource();
+    parallelConsolidationAllocatesFromResource();
+    parallelConsolidationAfterBulkDeleteStaysOnCallingThread();
+    allocateFromMonotonicBuffer();
+    decreaseKeyReusesHollowNodes();
+    keepTopKOfStreamWithoutAllocations();
+
+    spillToDiskAndExtractInOrder();
+    interleaveInsertsWithSpilledRuns();
+    mergeRunsPastFanIn();
+    mergeSortedRuns();
+    mergeMoreRunsThanOpenFiles();
+    exclusiveWriterKeepsExistingFile();
+
+    cloneIsIndependentOfOriginal();
+    unsharedHeapCopiesNoNodes();
+    forkManyTimes();
+    mergeKeepsOtherHeap();
+    mergeWithOwnClone();
+
+#if __cplusplus >= 202002L
+    wakeTasksByDeadline();
+    wakeDueTasksByPriority();
+    raisePriorityOfWaitingTask();
+    yieldAfterReprioritize();
+    cancelWaitingTask();
+#endif
 }
\ No newline at end of file